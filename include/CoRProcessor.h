@@ -7,6 +7,7 @@
 #include <glm/glm.hpp>
 #include "FBXLoader.h"
 #include <cor/CoRCalculator.h>
+#include <cor/CoRFile.h>
 
 
 class CoRProcessor {
@@ -17,13 +18,21 @@ public:
         unsigned int numThreads,
         float subdivEpsilon = 0.5f,
         bool useBFS = false,
-        float bfsEpsilon = 1e-6f);
+        float bfsEpsilon = 1e-6f,
+        bool aggregateTriangles = true);
 
-    // Compute CoRs asynchronously.
-    void ComputeCoRsAsync(const FBXLoader::FBXMeshData& mesh, unsigned int numBones, std::function<void(std::vector<glm::vec3>&)> callback);
+    // Compute CoRs asynchronously. The job reports progress and can cancel the bake.
+    std::shared_ptr<CoR::CoRJob> ComputeCoRsAsync(const FBXLoader::FBXMeshData& mesh, unsigned int numBones, std::function<void(std::vector<glm::vec3>&)> callback);
 
     // Load CoRs from a binary file.
-    std::vector<glm::vec3> LoadCoRsFromBinaryFile(const std::string& filepath) const;
+    std::vector<glm::vec3> LoadCoRsFromBinaryFile(const std::string& filepath, bool verifyChecksum = false) const;
+
+    // Map a binary file and return its CoRs in place, valid until the next call or until the processor is destroyed.
+    // Empty if the file cannot be read; verifyChecksum reads the whole file once to check it.
+    CoR::CoRSpan MapCoRsFromBinaryFile(const std::string& filepath, bool verifyChecksum = false);
+
+    // Encoding of the file last mapped by MapCoRsFromBinaryFile.
+    CoR::CoREncoding MappedCoREncoding() const;
     
     // Save CoRs to a binary file.
     void saveCoRsToBinaryFile(const std::string& filepath, std::vector<glm::vec3>& cors) const;
@@ -39,8 +48,12 @@ private:
     float subdivEpsilon_;
     bool  useBFS_;
     float bfsEpsilon_;
+    bool  aggregateTriangles_;
 
     // Internal calculators
     std::unique_ptr<CoR::CoRCalculator>    calc_;
     std::unique_ptr<CoR::BFSCoRCalculator> bfsCalc_;
+
+    // File behind the span of MapCoRsFromBinaryFile
+    CoR::MappedCoRFile corFile_;
 };
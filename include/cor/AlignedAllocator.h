@@ -0,0 +1,58 @@
+#ifndef CORCALCULATOR_ALIGNEDALLOCATOR_H
+#define CORCALCULATOR_ALIGNEDALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+
+namespace CoR {
+    // std::allocator replacement returning memory aligned for 256-bit vector loads
+    template <typename T, std::size_t Alignment = 32>
+    struct AlignedAllocator {
+        typedef T value_type;
+
+        template <typename U>
+        struct rebind {
+            typedef AlignedAllocator<U, Alignment> other;
+        };
+
+        AlignedAllocator() = default;
+        template <typename U>
+        AlignedAllocator(const AlignedAllocator<U, Alignment> &) {}
+
+        T * allocate(std::size_t n) {
+            void *p = nullptr;
+#ifdef _MSC_VER
+            p = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+            if (posix_memalign(&p, Alignment, n * sizeof(T)) != 0)
+                p = nullptr;
+#endif
+            if (!p)
+                throw std::bad_alloc();
+            return static_cast<T*>(p);
+        }
+
+        void deallocate(T *p, std::size_t) {
+#ifdef _MSC_VER
+            _aligned_free(p);
+#else
+            std::free(p);
+#endif
+        }
+
+        template <typename U>
+        bool operator == (const AlignedAllocator<U, Alignment> &) const { return true; }
+        template <typename U>
+        bool operator != (const AlignedAllocator<U, Alignment> &) const { return false; }
+    };
+
+    typedef std::vector<float, AlignedAllocator<float>> AlignedFloats;
+}
+
+#endif //CORCALCULATOR_ALIGNEDALLOCATOR_H
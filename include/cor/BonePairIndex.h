@@ -0,0 +1,56 @@
+#ifndef CORCALCULATOR_BONEPAIRINDEX_H
+#define CORCALCULATOR_BONEPAIRINDEX_H
+
+#include <cstdint>
+#include <vector>
+
+#include "CoRTriangleStore.h"
+#include "ThreadPool.h"
+#include "WeightsPerBone.h"
+
+namespace CoR {
+    /**
+     * Inverted index from bone pairs (j, k) to the triangle store entries with
+     * nonzero weights on both bones. The term of pair (j, k) in similarity()
+     * is a_j a_k b_j b_k exp(-d^2 / sigma^2) with
+     * d = a_j b_k - a_k b_j = |a| |b| sin(theta_b - theta_a), where a and b are
+     * the (j, k) weights of triangle and vertex and theta their polar angles.
+     *
+     * Entries of a pair are split into radius buckets by |a| and sorted by theta
+     * within a bucket. A query with radius R = sigma * sqrt(-ln cutoff) visits,
+     * per bucket, only the angle window where |a| |b| |sin(dtheta)| <= R, so it
+     * reports every entry with at least one term whose exponential factor is at
+     * least cutoff.
+     *
+     * Entries added or given new weights after build() are kept in unindexed
+     * and reported by every query until the next build().
+     */
+    struct BonePairIndex {
+        static const unsigned int BucketsPerPair = 8;
+
+        // sorted (j << 16 | k) keys; pair p owns buckets [pairBuckets[p], pairBuckets[p + 1])
+        std::vector<std::uint32_t> pairs;
+        std::vector<unsigned int> pairBuckets;
+        // bucket b owns entries [bucketOffsets[b], bucketOffsets[b + 1])
+        std::vector<unsigned int> bucketOffsets;
+        std::vector<float> bucketMinRadius;
+        std::vector<float> angles;
+        std::vector<unsigned int> entries;
+        // sorted
+        std::vector<unsigned int> unindexed;
+
+        void build(const CoRTriangleStore &store, ThreadPool *pool = nullptr);
+
+        // changed must be sorted
+        void addUnindexed(const std::vector<unsigned int> &changed);
+
+        bool empty() const {
+            return pairs.empty() && unindexed.empty();
+        }
+
+        // appends the candidate entries for weight w; an entry shows up once per matching pair
+        void query(const WeightsPerBone &w, float radius, std::vector<unsigned int> &candidates) const;
+    };
+}
+
+#endif //CORCALCULATOR_BONEPAIRINDEX_H
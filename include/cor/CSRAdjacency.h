@@ -0,0 +1,56 @@
+#ifndef CORCALCULATOR_CSRADJACENCY_H
+#define CORCALCULATOR_CSRADJACENCY_H
+
+#include <vector>
+
+#include "CoRStats.h"
+#include "CoRTriangle.h"
+
+namespace CoR {
+    /**
+     * Adjacency lists in compressed sparse row layout: the entries of row r are
+     * indices[offsets[r] .. offsets[r + 1]). Rows are vertices or triangles,
+     * entries are triangle indices, so copies stay valid and cost two vectors.
+     */
+    struct CSRAdjacency {
+        struct Row {
+            const unsigned int *first, *last;
+
+            const unsigned int * begin() const {
+                return first;
+            }
+
+            const unsigned int * end() const {
+                return last;
+            }
+
+            unsigned int size() const {
+                return static_cast<unsigned int>(last - first);
+            }
+        };
+
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> indices;
+
+        unsigned long size() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        Row operator[](unsigned long row) const {
+            return Row{indices.data() + offsets[row], indices.data() + offsets[row + 1]};
+        }
+
+        // triangles incident to each vertex, in triangle order
+        void buildVertexTriangles(const std::vector<CoRTriangle> &triangles, unsigned long vertexCount);
+
+        /**
+         * Triangles sharing an edge with each triangle, sorted by index. Edges are
+         * bucketed by their lower vertex, so this runs in O(T) and does not need
+         * any other adjacency. All triangles around a non-manifold edge become
+         * neighbours of each other; degenerate edges are ignored.
+         */
+        EdgeStatistics buildTriangleNeighbours(const std::vector<CoRTriangle> &triangles, unsigned long vertexCount);
+    };
+}
+
+#endif //CORCALCULATOR_CSRADJACENCY_H
@@ -13,6 +13,7 @@ namespace CoR {
         std::chrono::high_resolution_clock::time_point StartTime;
         void clockStart();
         void clockMessageAtCurrentTime(const std::string & message = "") const;
+        double elapsedSeconds() const;
     };
 }
 
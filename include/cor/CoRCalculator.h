@@ -5,18 +5,28 @@ Author      :   Paul Maximilian Bittner
 #ifndef COR_CORCALCULATOR_H
 #define COR_CORCALCULATOR_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <future>
+#include <memory>
 
 #include "WeightsPerBone.h"
+#include "Clock.h"
+#include "CoRCheckpoint.h"
+#include "CoRFile.h"
+#include "CoRJob.h"
 #include "CoRMesh.h"
-
-#define COR_ENABLE_PROFILING
+#include "CoRStats.h"
+#include "MeshSubdivider.h"
+#include "ThreadPool.h"
 
 namespace CoR {
 	class CoRCalculator {
+		// declared before _worker, so a running bake finishes before the pool goes away
+		std::shared_ptr<ThreadPool> _pool;
 		std::future<void> _worker;
+		mutable CoRStatsCollector _stats;
 
 	protected:
 		// cor computation values
@@ -25,21 +35,90 @@ namespace CoR {
 
 		int _numThreads;
 		bool _subdivide;
+		bool _aggregateTriangles;
+		float _similarityCutoff = 0;
+		SubdivisionLimits _subdivisionLimits;
+
+		ThreadPool & threadPool() const {
+			return *_pool;
+		}
 
 		// pre-calculation
-		virtual void convertTriangles(std::vector<unsigned int> triangleIndices, CoRMesh *mesh) const;
+		virtual void convertTriangles(const std::vector<unsigned int> & triangleIndices, CoRMesh *mesh) const;
+		// centers, areas and average weights of mesh->triangles
+		void buildTriangleStore(CoRMesh *mesh) const;
+		// calculator specific data, run after the triangles and weight classes are set up
+		virtual void calculateMeshData(CoRMesh * /*mesh*/) const {
+		}
+		// replaces the store entries of the ascending modifiedTriangles, returns the changed or appended entries
+		std::vector<unsigned int> patchTriangleStore(CoRMesh *mesh, const std::vector<unsigned int> & modifiedTriangles,
+													 const std::vector<WeightsPerBone> & oldAverages, const std::vector<WeightsPerBone> & newAverages) const;
+		// refreshes the calculator specific data after updateCoRs changed the weights of classes and store entries
+		virtual void updateWeightData(CoRMesh * /*mesh*/, const std::vector<unsigned int> & /*changedClasses*/,
+									  const std::vector<unsigned int> & /*changedEntries*/) const {
+		}
+		// rebuilds the calculator specific data indexed by weight class after updateCoRs renumbered the classes
+		virtual void calculateClassData(CoRMesh * /*mesh*/) const {
+		}
+
+		// the weight classes of mesh, built into localClasses if the mesh has none
+		const WeightClasses & weightClassesOf(const CoRMesh & mesh, WeightClasses & localClasses) const;
+		// parameters that change the baked cors, part of bakeHash()
+		virtual void hashParameters(Fnv1a & fnv) const;
+
+		// records the time since clock started as the named stage of stats()
+		void finishStage(const std::string & name, const Clock & clock) const;
+		// records the mesh's edge counts in stats()
+		void recordEdges(const EdgeStatistics & edges) const {
+			_stats.setEdges(edges);
+		}
 
         // cor computation
-        virtual bool calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut) const;
+        virtual bool calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut, CoRCounters &counters) const;
+        bool calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut) const;
         // [from, to)
         void calculateCoRs_Interval(unsigned long from, unsigned long to, const CoRMesh &mesh, std::vector<glm::vec3>& cors) const;
+        // cors of the weight classes [from, to), evaluated at their representative vertex
+        void calculateWeightClassCoRs_Interval(unsigned long from, unsigned long to, const CoRMesh &mesh, const WeightClasses &classes, std::vector<glm::vec3>& classCors) const;
 
 	public:
+		// numberOfThreadsToCreate = 0 shares ThreadPool::shared(), otherwise the calculator gets a private pool
 		explicit CoRCalculator(
 				float sigma = 0.1f,
 				float omega = 0.1f,
 				bool subdivide = true,
-				unsigned int numberOfThreadsToCreate = 4);
+				unsigned int numberOfThreadsToCreate = 0,
+				bool aggregateTriangles = false);
+		// runs on pool, e.g. to share it between bakes; a null pool shares ThreadPool::shared()
+		explicit CoRCalculator(
+				const std::shared_ptr<ThreadPool> & pool,
+				float sigma = 0.1f,
+				float omega = 0.1f,
+				bool subdivide = true,
+				bool aggregateTriangles = false);
+
+		// shares a pool between calculators, e.g. to run several bakes without oversubscribing the cores
+		void setThreadPool(const std::shared_ptr<ThreadPool> & pool) {
+			_pool = pool;
+		}
+
+		void setSubdivisionLimits(const SubdivisionLimits & limits) {
+			_subdivisionLimits = limits;
+		}
+
+		/**
+		 * Lets the brute force integral skip, via a bone pair index built into the mesh,
+		 * every triangle whose Gaussian factors exp(-d^2 / sigma^2) are all below cutoff.
+		 * Must be set before createCoRMesh; 0 evaluates every triangle.
+		 */
+		void setSimilarityCutoff(float cutoff) {
+			_similarityCutoff = cutoff;
+		}
+
+		// counters of the last calculateCoRsAsync, bakeCoRsTiled, bakeCoRShard or updateCoRs and the latest time of every stage
+		CoRStats stats() const {
+			return _stats.snapshot();
+		}
 
 		std::vector<WeightsPerBone> convertWeights(unsigned int numBones,
 												   const std::vector<std::vector<unsigned int>>& skeletonBoneIndices,
@@ -50,33 +129,129 @@ namespace CoR {
 				const std::vector<unsigned int>& indices,
 				std::vector<WeightsPerBone>& skeletonBoneWeights,
 				float subdivEpsilon = 0.1f) const;
+		// takes over the buffers instead of copying them
+		CoRMesh createCoRMesh(
+				std::vector<glm::vec3>&& vertices,
+				std::vector<unsigned int>&& indices,
+				std::vector<WeightsPerBone>&& skeletonBoneWeights,
+				float subdivEpsilon = 0.1f) const;
+
+		// the returned job reports progress and cancels the bake; callback only runs if it completes
+		std::shared_ptr<CoRJob> calculateCoRsAsync(const CoRMesh & mesh, const std::function<void(std::vector<glm::vec3>&)> & callback);
+
+		/**
+		 * Replaces the weights of changedVertices (vertex ids of mesh) by newWeights and
+		 * recomputes only the cors that can change: those of vertices sharing a bone pair
+		 * with the old or new average weight of a triangle around a changed vertex.
+		 * Only the store entries of those triangles and the changed weight classes
+		 * are patched, the calculator data is updated in place, or rebuilt for the
+		 * weight classes when emptied ones are compacted away. Returns the
+		 * recomputed vertices, or none if the arguments do not match the mesh.
+		 * Midpoints added by subdivision keep their interpolated weights.
+		 */
+		std::vector<unsigned int> updateCoRs(
+				CoRMesh & mesh,
+				const std::vector<unsigned int> & changedVertices,
+				const std::vector<WeightsPerBone> & newWeights,
+				std::vector<glm::vec3> & cors) const;
+
+		// identifies the cors of a mesh baked with this calculator's parameters
+		std::uint64_t bakeHash(const CoRMesh & mesh) const;
+
+		/**
+		 * Streaming bake: computes tiles of tileSize vertices in order and appends
+		 * every finished tile to the CoRCheckpoint at checkpointPath. A checkpoint of
+		 * the same mesh and parameters resumes after its last complete tile. Blocks
+		 * until done; returns false if job was cancelled or the checkpoint could not be
+		 * written, which leaves it resumable. The result is read with CoRCheckpoint::load.
+		 */
+		bool bakeCoRsTiled(const CoRMesh & mesh, const std::string & checkpointPath, unsigned int tileSize = 65536, CoRJob * job = nullptr) const;
 
-		void calculateCoRsAsync(const CoRMesh & mesh, const std::function<void(std::vector<glm::vec3>&)> & callback);
+		/**
+		 * Shard mode for multi-process bakes: computes the cors of vertices [from, to)
+		 * and writes them with bakeHash(mesh) as a CoRShard file. Blocks until done;
+		 * returns false if the range exceeds the mesh, job was cancelled or the file could
+		 * not be written.
+		 */
+		bool bakeCoRShard(const CoRMesh & mesh, unsigned long from, unsigned long to, const std::string & shardPath, CoRJob * job = nullptr) const;
 
-		// IO
-		void saveCoRsToBinaryFile(const std::string & path, std::vector<glm::vec3>& cors) const;
-		void saveCoRsToTextFile(const std::string & path, std::vector<glm::vec3>& cors, const std::string & separator = ", ") const;
-		std::vector<glm::vec3> loadCoRsFromBinaryFile(const std::string & path) const;
+		// IO, binary files are CoRFile; use MappedCoRFile to read big files in place
+		static bool saveCoRsToBinaryFile(const std::string & path, const std::vector<glm::vec3>& cors, std::uint64_t hash = 0,
+										 CoREncoding encoding = CoREncoding::Float32);
+		static void saveCoRsToTextFile(const std::string & path, std::vector<glm::vec3>& cors, const std::string & separator = ", ");
+		// also reads the legacy format; empty if the file cannot be read or verifyChecksum finds it corrupt
+		static std::vector<glm::vec3> loadCoRsFromBinaryFile(const std::string & path, bool verifyChecksum = false);
 	};
 
 	class BFSCoRCalculator : public CoRCalculator {
 
 		float _bfsEpsilon = 0.000001f;
+		float _annApproximation = 0;
 
 		void calculateANNData(CoRMesh * mesh, float omega) const;
 
 	protected:
-		void convertTriangles(std::vector<unsigned int> triangleIndices, CoRMesh *mesh) const override;
+		void calculateMeshData(CoRMesh *mesh) const override;
+		void updateWeightData(CoRMesh *mesh, const std::vector<unsigned int> & changedClasses, const std::vector<unsigned int> & changedEntries) const override;
+		void calculateClassData(CoRMesh *mesh) const override;
+		void hashParameters(Fnv1a & fnv) const override;
 
 	public:
 		explicit BFSCoRCalculator(
 				float sigma = 0.1f,
 				float omega = 0.1f,
 				bool subdivide = true,
-				unsigned int numberOfThreadsToCreate = 4,
-				float bfsEpsilon = 0.000001f);
+				unsigned int numberOfThreadsToCreate = 0,
+				float bfsEpsilon = 0.000001f,
+				float annApproximation = 0);
+		explicit BFSCoRCalculator(
+				const std::shared_ptr<ThreadPool> & pool,
+				float sigma = 0.1f,
+				float omega = 0.1f,
+				bool subdivide = true,
+				float bfsEpsilon = 0.000001f,
+				float annApproximation = 0);
+
+		using CoRCalculator::calculateCoR;
+		bool calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut, CoRCounters &counters) const override;
+	};
+
+	/**
+	 * Barnes-Hut style approximation of the integral over a WeightSpaceTree. A
+	 * node whose similarity bounds are loose is replaced by its children, the
+	 * loosest (by bound gap times area) first, until the similarity weighted area
+	 * is known within the relative tolerance. Every node left unrefined counts with
+	 * the mean of its bounds, so a cor moves by at most about tolerance times the
+	 * extent of the triangles it depends on. Leaves are summed exactly.
+	 */
+	class HierarchicalCoRCalculator : public CoRCalculator {
+
+		float _tolerance;
+		unsigned int _leafSize;
+
+	protected:
+		void calculateMeshData(CoRMesh *mesh) const override;
+		void updateWeightData(CoRMesh *mesh, const std::vector<unsigned int> & changedClasses, const std::vector<unsigned int> & changedEntries) const override;
+		void hashParameters(Fnv1a & fnv) const override;
+
+	public:
+		explicit HierarchicalCoRCalculator(
+				float sigma = 0.1f,
+				float omega = 0.1f,
+				bool subdivide = true,
+				unsigned int numberOfThreadsToCreate = 0,
+				float tolerance = 0.01f,
+				unsigned int leafSize = 32);
+		explicit HierarchicalCoRCalculator(
+				const std::shared_ptr<ThreadPool> & pool,
+				float sigma = 0.1f,
+				float omega = 0.1f,
+				bool subdivide = true,
+				float tolerance = 0.01f,
+				unsigned int leafSize = 32);
 
-		bool calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut) const override;
+		using CoRCalculator::calculateCoR;
+		bool calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut, CoRCounters &counters) const override;
 	};
 }
 
@@ -0,0 +1,93 @@
+#ifndef CORCALCULATOR_CORCHECKPOINT_H
+#define CORCALCULATOR_CORCHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "CoRMesh.h"
+
+namespace CoR {
+    // FNV-1a, used for mesh hashes and payload checksums of the CoR files
+    struct Fnv1a {
+        std::uint64_t value = 14695981039346656037ull;
+
+        void update(const void *data, std::size_t size) {
+            const unsigned char *bytes = static_cast<const unsigned char *>(data);
+            for (std::size_t i = 0; i < size; ++i)
+                value = (value ^ bytes[i]) * 1099511628211ull;
+        }
+
+        template<typename T>
+        void update(const T &value) {
+            update(&value, sizeof(T));
+        }
+    };
+
+    // hash of the vertices, triangles and weights of a mesh
+    std::uint64_t hashMesh(const CoRMesh &mesh);
+
+    /**
+     * Append-only file of baked CoR tiles. Tile i holds the cors of vertices
+     * [i * tileSize, min((i + 1) * tileSize, vertexCount)) and is written with
+     * its index and a payload checksum, so a bake killed mid-write loses at most
+     * the tile it was writing. Opening a checkpoint of the same vertex count,
+     * tile size and hash resumes after its last complete tile; any other file at
+     * the path is started over. I/O errors leave the complete tiles in place, so
+     * the checkpoint can be resumed once the cause is fixed.
+     *
+     * Layout: header {"CORCKPT1", uint32 version, uint32 tileSize,
+     * uint64 vertexCount, uint64 hash}, then per tile {uint64 tile,
+     * uint32 count, uint32 checksum, float[3 * count]}.
+     */
+    class CoRCheckpoint {
+    public:
+        CoRCheckpoint(const std::string &path, unsigned long vertexCount, unsigned int tileSize, std::uint64_t hash);
+
+        // false if the file could not be opened or a tile could not be written
+        bool good() const {
+            return static_cast<bool>(_file);
+        }
+
+        unsigned long tileCount() const {
+            return (_vertexCount + _tileSize - 1) / _tileSize;
+        }
+
+        unsigned long completeTiles() const {
+            return _completeTiles;
+        }
+
+        bool complete() const {
+            return _completeTiles == tileCount();
+        }
+
+        // first vertex and vertex count of a tile
+        unsigned long tileBegin(unsigned long tile) const {
+            return tile * _tileSize;
+        }
+
+        unsigned int tileVertexCount(unsigned long tile) const;
+
+        // appends the next tile and flushes it to disk; false if it could not be written
+        bool appendTile(const glm::vec3 *cors);
+
+        /**
+         * Reads the cors of a complete checkpoint. Returns false and leaves cors
+         * empty if the file is missing, damaged or incomplete, or its hash
+         * differs from expectedHash (unless expectedHash is 0).
+         */
+        static bool load(const std::string &path, std::vector<glm::vec3> &cors, std::uint64_t expectedHash = 0);
+
+    private:
+        std::fstream _file;
+        unsigned long _vertexCount;
+        unsigned int _tileSize;
+        std::uint64_t _hash;
+        unsigned long _completeTiles;
+    };
+}
+
+#endif //CORCALCULATOR_CORCHECKPOINT_H
@@ -0,0 +1,141 @@
+#ifndef CORCALCULATOR_CORFILE_H
+#define CORCALCULATOR_CORFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+
+namespace CoR {
+    struct QuantizedCoRs;
+
+    enum class CoREncoding : std::uint32_t {
+        // packed glm::vec3, usable in place
+        Float32 = 0,
+        // QuantizedCoRs coded by encodeQuantizedCoRs, decoded on load
+        Quantized16 = 1
+    };
+
+    /**
+     * Header of a .cors file. The payload of payloadSize bytes starts at
+     * payloadOffset, a multiple of 16, so a mapped Float32 file can be used in
+     * place; its count cors are stride bytes apart. endianness holds
+     * EndiannessMarker in the writer's byte order, checksum is FNV-1a of the
+     * payload and hash is the calculator's bakeHash, or 0 if unknown.
+     */
+    struct CoRFileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t endianness;
+        std::uint64_t count;
+        std::uint32_t stride;
+        std::uint32_t payloadOffset;
+        std::uint64_t hash;
+        std::uint64_t checksum;
+        std::uint32_t encoding;
+        std::uint32_t reserved;
+        std::uint64_t payloadSize;
+
+        static const std::uint32_t Version = 1;
+        static const std::uint32_t EndiannessMarker = 0x01020304;
+    };
+    static_assert(sizeof(CoRFileHeader) == 64, "the .cors header is 64 bytes");
+
+    // contiguous read-only cors, C++11 stand-in for std::span<const glm::vec3>
+    struct CoRSpan {
+        const glm::vec3 *data = nullptr;
+        std::size_t size = 0;
+
+        const glm::vec3 *begin() const {
+            return data;
+        }
+
+        const glm::vec3 *end() const {
+            return data + size;
+        }
+
+        const glm::vec3 & operator [] (std::size_t i) const {
+            return data[i];
+        }
+    };
+
+    /**
+     * Writes to a temporary file next to path and renames it; false if the file
+     * could not be written. Quantized16 files are lossy, see QuantizedCoRs.
+     */
+    bool writeCoRFile(const std::string &path, const glm::vec3 *cors, std::size_t count, std::uint64_t hash = 0,
+                      CoREncoding encoding = CoREncoding::Float32);
+    // writes cors quantized earlier as a Quantized16 file
+    bool writeCoRFile(const std::string &path, const QuantizedCoRs &quantized, std::uint64_t hash = 0);
+
+    /**
+     * Read-only view of a .cors file. A file of this platform's byte order and
+     * stride is memory mapped and cors() points into the mapping, so opening
+     * it costs neither parsing nor copying. Quantized16 and byte-swapped
+     * files and files of the legacy format (ASCII count followed by raw
+     * floats) are decoded into memory instead, legacy() tells the latter apart.
+     */
+    class MappedCoRFile {
+    public:
+        MappedCoRFile() = default;
+        ~MappedCoRFile();
+
+        MappedCoRFile(const MappedCoRFile &) = delete;
+        MappedCoRFile & operator = (const MappedCoRFile &) = delete;
+
+        /**
+         * Returns false and describes the problem in error if the file is
+         * missing, truncated or of an unknown version. verifyChecksum reads the
+         * whole payload once to check it.
+         */
+        bool open(const std::string &path, bool verifyChecksum = false, std::string *error = nullptr);
+        void close();
+
+        CoRSpan cors() const {
+            return _cors;
+        }
+
+        std::uint64_t hash() const {
+            return _hash;
+        }
+
+        bool legacy() const {
+            return _legacy;
+        }
+
+        bool mapped() const {
+            return _mapping != nullptr;
+        }
+
+        // Float32 for legacy files
+        CoREncoding encoding() const {
+            return _encoding;
+        }
+
+    private:
+        CoRSpan _cors;
+        std::uint64_t _hash = 0;
+        bool _legacy = false;
+        CoREncoding _encoding = CoREncoding::Float32;
+
+        // cors that could not be used in place
+        std::vector<glm::vec3> _storage;
+
+        const unsigned char *_mapping = nullptr;
+        std::size_t _mappingSize = 0;
+#ifdef _WIN32
+        void *_fileHandle = nullptr;
+        void *_mappingHandle = nullptr;
+#endif
+
+        bool map(const std::string &path, std::string *error);
+        void unmap();
+        bool readLegacy(std::string *error);
+        bool readQuantized(const CoRFileHeader &header, bool swapped, std::string *error);
+        // closes the file and returns false
+        bool fail(const std::string &message, std::string *error);
+    };
+}
+
+#endif //CORCALCULATOR_CORFILE_H
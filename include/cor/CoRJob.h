@@ -0,0 +1,83 @@
+#ifndef CORCALCULATOR_CORJOB_H
+#define CORCALCULATOR_CORJOB_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "Clock.h"
+
+namespace CoR {
+    /**
+     * Handle of a running CoR bake. Progress is counted in vertices and can be
+     * polled lock-free from any thread. cancel() asks the workers to stop; they
+     * check it between chunks, and a cancelled bake does not call its callback.
+     */
+    class CoRJob {
+    public:
+        explicit CoRJob(unsigned long totalVertices = 0);
+
+        unsigned long done() const {
+            return _done.load(std::memory_order_relaxed);
+        }
+
+        unsigned long total() const {
+            return _total.load(std::memory_order_relaxed);
+        }
+
+        // part of done() that an earlier run had completed, e.g. a resumed checkpoint
+        unsigned long resumed() const {
+            return _resumed.load(std::memory_order_relaxed);
+        }
+
+        // fraction of vertices done in [0, 1]
+        float progress() const;
+        double elapsedSeconds() const;
+        // remaining time extrapolated from the vertices done in this run, negative while unknown
+        double etaSeconds() const;
+
+        void cancel() {
+            _cancelled.store(true, std::memory_order_relaxed);
+        }
+
+        bool cancelled() const {
+            return _cancelled.load(std::memory_order_relaxed);
+        }
+
+        // finished or cancelled, the workers are idle
+        bool finished() const {
+            return _finished.load(std::memory_order_acquire);
+        }
+
+        void wait() const;
+        // true if the job finished within the timeout
+        bool waitFor(double seconds) const;
+
+        // worker side
+        void setTotal(unsigned long totalVertices) {
+            _total.store(totalVertices, std::memory_order_relaxed);
+        }
+
+        void advance(unsigned long vertices) {
+            _done.fetch_add(vertices, std::memory_order_relaxed);
+        }
+
+        // vertices done by an earlier run, counted as done but not towards the rate of this one
+        void resume(unsigned long vertices) {
+            _resumed.fetch_add(vertices, std::memory_order_relaxed);
+            _done.fetch_add(vertices, std::memory_order_relaxed);
+        }
+
+        void finish();
+
+    private:
+        std::atomic<unsigned long> _done, _total, _resumed;
+        std::atomic<bool> _cancelled, _finished;
+        Clock _clock;
+
+        mutable std::mutex _mutex;
+        mutable std::condition_variable _finishedCondition;
+    };
+}
+
+#endif //CORCALCULATOR_CORJOB_H
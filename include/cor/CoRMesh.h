@@ -5,27 +5,59 @@
 #ifndef CORCALCULATOR_CORMESH_H
 #define CORCALCULATOR_CORMESH_H
 
+#include <algorithm>
+#include <utility>
+
+#include "BonePairIndex.h"
 #include "CoRTriangle.h"
+#include "CSRAdjacency.h"
+#include "CoRTriangleStore.h"
+#include "WeightClasses.h"
+#include "WeightNeighbourIndex.h"
+#include "WeightSpaceTree.h"
+#include "WeightsPerBone.h"
 
 namespace CoR {
     struct CoRMesh {
         std::vector<glm::vec3> vertices;
         std::vector<CoRTriangle> triangles;
         std::vector<WeightsPerBone> weights;
+        // largest influence count of the weights, picks the SimilarityKernel specialization
+        int maxInfluences;
+
+        // centers, areas and average weights of the triangles in SoA layout
+        CoRTriangleStore triangleStore;
+        // entries updateCoRs appended to an aggregated store since it was built
+        unsigned long appendedEntries = 0;
+        // bone pairs to store entries, only built with a similarity cutoff
+        BonePairIndex bonePairs;
 
         // triangle adjacency graph
-        std::vector<std::vector<CoRTriangle*>> trianglesOfVertex;
-        std::vector<std::vector<int>> verticesWithSimilarSkinningWeights;
+        CSRAdjacency trianglesOfVertex;
+        CSRAdjacency triangleNeighbours;
+
+        // vertices grouped by identical weights and the classes with similar skinning weights
+        WeightClasses weightClasses;
+        WeightNeighbourIndex similarWeightClasses;
+
+        // store entries clustered in weight space, built by HierarchicalCoRCalculator
+        WeightSpaceTree weightTree;
 
         CoRMesh(
-                const std::vector<glm::vec3> & vertices,
-                const std::vector<CoRTriangle> & triangles,
-                const std::vector<WeightsPerBone> & weights)
-                : vertices(vertices),
-                  triangles(triangles),
-                  weights(weights)
+                std::vector<glm::vec3> vertices,
+                std::vector<CoRTriangle> triangles,
+                std::vector<WeightsPerBone> weights)
+                : vertices(std::move(vertices)),
+                  triangles(std::move(triangles)),
+                  weights(std::move(weights))
         {
+            updateMaxInfluences();
+        }
 
+        void updateMaxInfluences() {
+            maxInfluences = 0;
+            for (const WeightsPerBone &w : weights)
+                maxInfluences = std::max(maxInfluences, w.size());
         }
     };
 }
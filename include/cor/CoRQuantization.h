@@ -0,0 +1,54 @@
+#ifndef CORCALCULATOR_CORQUANTIZATION_H
+#define CORCALCULATOR_CORQUANTIZATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/vec3.hpp>
+
+namespace CoR {
+    /**
+     * CoRs quantized to 16 bits per axis over their bounding box, a cor is
+     * origin + extent * q / 65535. That is exactly what a normalized
+     * GL_UNSIGNED_SHORT attribute reads, and the error per axis is at most
+     * half a step, extent / 131070.
+     */
+    struct QuantizedCoRs {
+        static const std::uint32_t Steps = 65535;
+
+        glm::vec3 origin = glm::vec3(0);
+        glm::vec3 extent = glm::vec3(0);
+        // x, y and z of every cor
+        std::vector<std::uint16_t> values;
+
+        std::size_t size() const {
+            return values.size() / 3;
+        }
+
+        glm::vec3 dequantize(std::size_t i) const;
+        std::vector<glm::vec3> dequantize() const;
+
+        static QuantizedCoRs quantize(const glm::vec3 *cors, std::size_t count);
+    };
+
+    // displacement of the dequantized cors from the cors they were quantized from
+    struct QuantizationError {
+        float max = 0;
+        float mean = 0;
+    };
+
+    QuantizationError quantizationError(const glm::vec3 *cors, const QuantizedCoRs &quantized);
+
+    /**
+     * Lossless disk coding of quantized cors: origin and extent, then every
+     * axis delta coded along the vertex order, zigzag mapped and Rice coded in
+     * blocks of 64 values, each block with the Rice parameter coding it
+     * shortest. Cors of one weight class share their value, so runs of
+     * similar vertices cost about a bit per axis.
+     */
+    void encodeQuantizedCoRs(const QuantizedCoRs &quantized, std::vector<std::uint8_t> &bytes);
+    // false if bytes do not hold count encoded cors
+    bool decodeQuantizedCoRs(const std::uint8_t *bytes, std::size_t size, std::size_t count, QuantizedCoRs &quantized);
+}
+
+#endif //CORCALCULATOR_CORQUANTIZATION_H
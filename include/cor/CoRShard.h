@@ -0,0 +1,38 @@
+#ifndef CORCALCULATOR_CORSHARD_H
+#define CORCALCULATOR_CORSHARD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/vec3.hpp>
+
+namespace CoR {
+    /**
+     * The cors of the vertex range [from, to) of a mesh with vertexCount
+     * vertices, baked by one worker process. hash is the calculator's bakeHash,
+     * so shards of different meshes or parameters are never merged.
+     *
+     * Layout: {"CORSHRD1", uint32 version, uint32 checksum, uint64 from,
+     * uint64 to, uint64 vertexCount, uint64 hash}, then float[3 * (to - from)].
+     */
+    struct CoRShard {
+        std::uint64_t from = 0, to = 0;
+        std::uint64_t vertexCount = 0;
+        std::uint64_t hash = 0;
+        std::vector<glm::vec3> cors;
+
+        // writes to a temporary file next to path and renames it, so readers never see a partial shard
+        bool write(const std::string &path) const;
+        // false if the file is missing, truncated or fails its checksum
+        bool read(const std::string &path);
+    };
+
+    /**
+     * Assembles shards into the cors of the whole mesh. The shards must agree on
+     * vertex count and hash and cover every vertex exactly once, in any order.
+     * On failure returns false and describes the problem in error.
+     */
+    bool mergeCoRShards(const std::vector<CoRShard> &shards, std::vector<glm::vec3> &cors, std::string &error);
+}
+
+#endif //CORCALCULATOR_CORSHARD_H
@@ -0,0 +1,81 @@
+#ifndef CORCALCULATOR_CORSTATS_H
+#define CORCALCULATOR_CORSTATS_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CoR {
+    // work counted by one thread, merged into the shared CoRStatsCollector once per chunk
+    struct CoRCounters {
+        unsigned long cors = 0;
+        unsigned long similarityEvaluations = 0;
+        // triangles whose similarity was evaluated
+        unsigned long trianglesVisited = 0;
+        // triangles left out as below the similarity threshold: skipped by the bone pair index
+        // or the hierarchy, or visited by the BFS, which stops there; 0 for the brute force
+        // integral, which sums every triangle
+        unsigned long trianglesPruned = 0;
+        unsigned long bfsDepthSum = 0;
+        unsigned long maxBfsDepth = 0;
+    };
+
+    struct EdgeStatistics {
+        unsigned long edges = 0;
+        // edges of a single triangle
+        unsigned long boundaryEdges = 0;
+        // edges shared by more than two triangles
+        unsigned long nonManifoldEdges = 0;
+    };
+
+    struct StageTime {
+        std::string name;
+        double seconds;
+    };
+
+    struct CoRStats {
+        unsigned long vertices = 0;
+        unsigned long weightClasses = 0;
+        CoRCounters counters;
+        // of the triangle adjacency, which only the BFS calculator builds
+        EdgeStatistics edges;
+        std::vector<StageTime> stages;
+
+        // 0 if the stage did not run
+        double stageSeconds(const std::string &name) const;
+
+        std::string toJSON() const;
+    };
+
+    /**
+     * Thread-safe accumulation of CoRStats. Counters are atomics that threads add
+     * their CoRCounters to, stage times are set once per stage, so collecting
+     * costs a few atomic operations per chunk of work.
+     */
+    class CoRStatsCollector {
+    public:
+        CoRStatsCollector();
+
+        void add(const CoRCounters &counters);
+        // replaces an earlier time of the same stage
+        void setStage(const std::string &name, double seconds);
+        void setSizes(unsigned long vertices, unsigned long weightClasses);
+        void setEdges(const EdgeStatistics &edges);
+        void resetCounters();
+
+        CoRStats snapshot() const;
+
+    private:
+        std::atomic<unsigned long> _vertices, _weightClasses;
+        std::atomic<unsigned long> _cors, _similarityEvaluations, _trianglesVisited, _trianglesPruned;
+        std::atomic<unsigned long> _bfsDepthSum, _maxBfsDepth;
+
+        // stages and edges, both set once per bake
+        mutable std::mutex _stagesMutex;
+        std::vector<StageTime> _stages;
+        EdgeStatistics _edges;
+    };
+}
+
+#endif //CORCALCULATOR_CORSTATS_H
@@ -0,0 +1,98 @@
+#ifndef CORCALCULATOR_CORTRIANGLESTORE_H
+#define CORCALCULATOR_CORTRIANGLESTORE_H
+
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "AlignedAllocator.h"
+#include "WeightsPerBone.h"
+
+namespace CoR {
+    /**
+     * The integration domain of the CoR computation in structure-of-arrays layout:
+     * centers and areas are contiguous aligned float streams, and the sparse
+     * average weights are packed in compressed rows. Entry t's weights are
+     * [weightOffsets[t], weightOffsets[t + 1]) of weightBones/weightValues.
+     */
+    struct CoRTriangleStore {
+        AlignedFloats centerX, centerY, centerZ;
+        AlignedFloats area;
+
+        std::vector<unsigned int> weightOffsets;
+        std::vector<unsigned short> weightBones;
+        AlignedFloats weightValues;
+
+        CoRTriangleStore() : weightOffsets(1, 0) {}
+
+        unsigned long size() const {
+            return area.size();
+        }
+
+        void clear() {
+            centerX.clear();
+            centerY.clear();
+            centerZ.clear();
+            area.clear();
+            weightOffsets.assign(1, 0);
+            weightBones.clear();
+            weightValues.clear();
+        }
+
+        void reserve(unsigned long triangles) {
+            centerX.reserve(triangles);
+            centerY.reserve(triangles);
+            centerZ.reserve(triangles);
+            area.reserve(triangles);
+            weightOffsets.reserve(triangles + 1);
+        }
+
+        // n entries with unset centers and areas and no weights, for filling in place
+        void resize(unsigned long triangles) {
+            centerX.resize(triangles);
+            centerY.resize(triangles);
+            centerZ.resize(triangles);
+            area.resize(triangles);
+            weightOffsets.assign(triangles + 1, 0);
+            weightBones.clear();
+            weightValues.clear();
+        }
+
+        void push_back(const glm::vec3 &center, float triangleArea, const WeightsPerBone &weight) {
+            centerX.push_back(center.x);
+            centerY.push_back(center.y);
+            centerZ.push_back(center.z);
+            area.push_back(triangleArea);
+            for (int i = 0; i < weight.size(); ++i) {
+                weightBones.push_back(static_cast<unsigned short>(weight.bone(i)));
+                weightValues.push_back(weight.weight(i));
+            }
+            weightOffsets.push_back(static_cast<unsigned int>(weightBones.size()));
+        }
+
+        glm::vec3 center(unsigned long t) const {
+            return glm::vec3(centerX[t], centerY[t], centerZ[t]);
+        }
+
+        /**
+         * Merges entries with identical weights into one entry with the summed area
+         * and the area-weighted center. The CoR integral is linear in
+         * area * center, so it does not change. Entries with fewer than two
+         * influences never contribute to a similarity and are dropped.
+         */
+        CoRTriangleStore aggregated() const;
+
+        /**
+         * Replaces the weights of entries, which must be ascending. They are
+         * overwritten in place unless an influence count changes, then the packed
+         * weights are relaid in one copy.
+         */
+        void setWeights(const std::vector<unsigned int> &entries, const std::vector<WeightsPerBone> &weights);
+
+        WeightsPerBone weight(unsigned long t) const {
+            unsigned int begin = weightOffsets[t];
+            return WeightsPerBone::fromSorted(weightBones.data() + begin, weightValues.data() + begin, weightOffsets[t + 1] - begin);
+        }
+    };
+}
+
+#endif //CORCALCULATOR_CORTRIANGLESTORE_H
@@ -0,0 +1,43 @@
+#ifndef CORCALCULATOR_MESHSUBDIVIDER_H
+#define CORCALCULATOR_MESHSUBDIVIDER_H
+
+#include <vector>
+#include <glm/vec3.hpp>
+
+#include "ThreadPool.h"
+#include "WeightsPerBone.h"
+
+namespace CoR {
+    struct SubdivisionLimits {
+        unsigned int maxPasses = 8;
+        // caps on the final vertex and triangle count relative to the input mesh
+        float maxVertexGrowth = 4.0f;
+        float maxTriangleGrowth = 4.0f;
+    };
+
+    /**
+     * Adaptive subdivision of edges whose skinning weights differ by at least
+     * epsilon. Every pass collects the edges to split, creates one midpoint per
+     * undirected edge through an edge->midpoint hash and replaces each triangle
+     * by 1-4 triangles, so neighbouring triangles agree on their shared
+     * midpoints and no T-junctions appear. Midpoints interpolate position and
+     * weights linearly. When a growth cap would be exceeded, the edges with the
+     * largest weight distance are split first and refinement stops.
+     */
+    class MeshSubdivider {
+    public:
+        explicit MeshSubdivider(float epsilon, const SubdivisionLimits &limits = SubdivisionLimits(), ThreadPool *pool = nullptr);
+
+        // refines the mesh in place and returns the number of split edges
+        unsigned long subdivide(std::vector<glm::vec3> &vertices, std::vector<unsigned int> &indices, std::vector<WeightsPerBone> &weights) const;
+
+    private:
+        float _epsilon;
+        SubdivisionLimits _limits;
+        ThreadPool *_pool;
+
+        void parallelFor(unsigned long begin, unsigned long end, const ThreadPool::RangeFunction &body) const;
+    };
+}
+
+#endif //CORCALCULATOR_MESHSUBDIVIDER_H
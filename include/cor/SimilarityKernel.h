@@ -0,0 +1,71 @@
+#ifndef CORCALCULATOR_SIMILARITYKERNEL_H
+#define CORCALCULATOR_SIMILARITYKERNEL_H
+
+#include "WeightsPerBone.h"
+#include "CoRTriangleStore.h"
+
+namespace CoR {
+    /**
+     * Evaluates similarity() of one vertex weight against many triangle weights,
+     * BatchSize triangles per vector instruction. The implementation is picked at
+     * runtime: AVX2+FMA, SSE2 or a scalar fallback on non-x86 targets.
+     *
+     * Each symmetric (j,k)/(k,j) bone pair is evaluated once. The vector paths use
+     * a polynomial exp approximation with a relative error below 2.5e-7 for
+     * arguments in [-87.3, 0]. Smaller arguments yield at most 1.2e-38, so the
+     * result stays within a few float ulps of similarity().
+     *
+     * The gather of the triangle weights is compiled for 4, 8 and Capacity
+     * vertex influences, and the narrowest one holding maxInfluences
+     * (CoRMesh::maxInfluences) is used. Up to 8 influences the vertex bones stay
+     * in registers and the weights are gathered without branching on bone ids.
+     * The pair sums loop over the vertex's actual pairs for every width.
+     */
+    class SimilarityKernel {
+    public:
+        static const int BatchSize = 8;
+        static const int MaxPairs = WeightsPerBone::Capacity * (WeightsPerBone::Capacity - 1) / 2;
+
+        static const int NarrowInfluences = 4;
+        static const int MediumInfluences = 8;
+        static const int WideInfluences = WeightsPerBone::Capacity;
+        static_assert(WeightsPerBone::Capacity >= MediumInfluences, "COR_MAX_BONE_INFLUENCES must be at least 8");
+
+        // bone pairs (j < k) of the vertex weight with their constant factors
+        struct PairTable {
+            int count;
+            int boneCount;
+            unsigned short bones[WeightsPerBone::Capacity];
+            unsigned char j[MaxPairs];
+            unsigned char k[MaxPairs];
+            float aj[MaxPairs];
+            float ak[MaxPairs];
+            float coefficient[MaxPairs]; // 2 * aj * ak
+        };
+
+        explicit SimilarityKernel(float sigma, int maxInfluences = WeightsPerBone::Capacity);
+
+        void setVertex(const WeightsPerBone &weight);
+
+        // simOut[i] = similarity(vertex, *weights[i], sigma)
+        void evaluate(const WeightsPerBone * const *weights, unsigned int count, float *simOut) const;
+        // simOut[i] = similarity with the weight of store entry first + i
+        void evaluate(const CoRTriangleStore &store, unsigned long first, unsigned int count, float *simOut) const;
+        // simOut[i] = similarity with the weight of store entry triangles[i]
+        void evaluateIndexed(const CoRTriangleStore &store, const unsigned int *triangles, unsigned int count, float *simOut) const;
+
+        // name of the instruction set chosen at runtime
+        static const char * instructionSet();
+
+        // the specialization (4, 8 or Capacity) used for the given influence count
+        static int specialization(int influences);
+
+    private:
+        float _negInvSigmaSquared;
+        int _maxInfluences;
+        int _influences;
+        PairTable _pairs;
+    };
+}
+
+#endif //CORCALCULATOR_SIMILARITYKERNEL_H
@@ -0,0 +1,75 @@
+#ifndef CORCALCULATOR_THREADPOOL_H
+#define CORCALCULATOR_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CoR {
+    /**
+     * Persistent work-stealing thread pool. Every worker owns a task deque: it
+     * pops its own tasks LIFO and steals from the other workers FIFO when it
+     * runs dry. Several calculators can share one pool to run bakes side by
+     * side without oversubscribing the cores.
+     */
+    class ThreadPool {
+    public:
+        typedef std::function<void(unsigned long, unsigned long)> RangeFunction;
+
+        // cpuAffinity[i % size] is the core worker i is pinned to; empty means no pinning
+        explicit ThreadPool(unsigned int workerCount = 0, const std::vector<int> &cpuAffinity = std::vector<int>());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool & operator = (const ThreadPool &) = delete;
+
+        unsigned int size() const {
+            return static_cast<unsigned int>(_workers.size());
+        }
+
+        /**
+         * Calls body(from, to) on chunks of [begin, end) holding at most grainSize
+         * indices (0 picks a grain giving every worker about 16 chunks) and
+         * blocks until all chunks are done. The calling thread runs tasks
+         * while it waits. The first exception thrown by body is rethrown here.
+         */
+        void parallelFor(unsigned long begin, unsigned long end, unsigned long grainSize, const RangeFunction &body);
+
+        // process-wide pool with one worker per hardware thread
+        static std::shared_ptr<ThreadPool> shared();
+
+    private:
+        struct TaskGroup;
+
+        struct Task {
+            TaskGroup *group;
+            unsigned long from, to;
+            const RangeFunction *body;
+        };
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        std::vector<std::thread> _workers;
+        std::vector<std::unique_ptr<Queue>> _queues;
+
+        std::mutex _sleepMutex;
+        std::condition_variable _wakeUp;
+        std::atomic<long> _queued;
+        bool _stop;
+
+        void workerLoop(unsigned int index);
+        bool tryPop(unsigned int index, Task &task);
+        bool trySteal(unsigned int thief, Task &task);
+        void run(const Task &task);
+    };
+}
+
+#endif //CORCALCULATOR_THREADPOOL_H
@@ -0,0 +1,55 @@
+#ifndef CORCALCULATOR_WEIGHTCLASSES_H
+#define CORCALCULATOR_WEIGHTCLASSES_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "WeightsPerBone.h"
+
+namespace CoR {
+    /**
+     * Groups vertices with identical skinning weights. build() numbers classes
+     * in order of their first vertex; the vertices of class c are
+     * vertices[offsets[c] .. offsets[c + 1]). Classes emptied by update() have
+     * no vertices until update() compacts them away.
+     */
+    struct WeightClasses {
+        std::vector<unsigned int> classOfVertex;
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> vertices;
+        // the weight of every class, an emptied class keeps its last one
+        std::vector<WeightsPerBone> weightOfClass;
+        // the class of every weight that has vertices
+        std::unordered_map<WeightsPerBone, unsigned int, WeightsPerBone::Hasher> classOfWeight;
+
+        void build(const std::vector<WeightsPerBone> &weights);
+
+        /**
+         * Moves changedVertices into the classes of their new weights and appends
+         * the classes that gained vertices, ascending, to changedClasses. Only the
+         * changed vertices are hashed, the others are relaid in one copy. A new
+         * weight joins the class that already has it; otherwise a class whose
+         * vertices all changed to it keeps its id, and the rest get appended
+         * classes. Once more than an eighth of the classes are empty they are
+         * compacted away, which renumbers the classes, changedClasses included,
+         * and returns true.
+         */
+        bool update(const std::vector<WeightsPerBone> &weights, const std::vector<unsigned int> &changedVertices,
+                    std::vector<unsigned int> &changedClasses);
+
+        unsigned long size() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        unsigned int count(unsigned long c) const {
+            return offsets[c + 1] - offsets[c];
+        }
+
+        // first vertex of class c, which must not be empty
+        unsigned int representative(unsigned long c) const {
+            return vertices[offsets[c]];
+        }
+    };
+}
+
+#endif //CORCALCULATOR_WEIGHTCLASSES_H
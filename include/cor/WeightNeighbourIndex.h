@@ -0,0 +1,55 @@
+#ifndef CORCALCULATOR_WEIGHTNEIGHBOURINDEX_H
+#define CORCALCULATOR_WEIGHTNEIGHBOURINDEX_H
+
+#include <memory>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "WeightsPerBone.h"
+
+namespace CoR {
+    class VantagePointTree;
+
+    /**
+     * Radius neighbourhoods in skinning weight space, stored per weight class.
+     * The classes closer than omega to class c (c itself included) are
+     * neighbours[offsets[c] .. offsets[c + 1]), sorted ascending.
+     *
+     * Queries run on a vantage-point tree over the class weights, so only
+     * subtrees that can hold a neighbour are visited. With approximation = 0 the
+     * result is exact. With approximation = e > 0 the search prunes with radius
+     * omega / (1 + e): all reported classes are within omega, and every class
+     * within omega / (1 + e) is reported.
+     *
+     * The tree and a copy of the class weights are kept for update(), which
+     * re-queries only the classes whose weights changed.
+     */
+    struct WeightNeighbourIndex {
+        std::vector<unsigned int> offsets;
+        std::vector<unsigned int> neighbours;
+
+        // queries run in parallel on pool if one is given
+        void build(const std::vector<WeightsPerBone> &classWeights, float omega, float approximation = 0, ThreadPool *pool = nullptr);
+
+        /**
+         * Gives changedClasses (ascending, ids >= size() are appended classes) the
+         * weights changedWeights, re-queries their neighbourhoods and patches them
+         * into the others. Changed classes are compared linearly until they
+         * outnumber an eighth of the tree, then it is rebuilt. Needs build() first.
+         */
+        void update(const std::vector<unsigned int> &changedClasses, const std::vector<WeightsPerBone> &changedWeights, ThreadPool *pool = nullptr);
+
+        unsigned long size() const {
+            return offsets.empty() ? 0 : offsets.size() - 1;
+        }
+
+        // search tree over the class weights of the last build
+        std::shared_ptr<const VantagePointTree> tree;
+        float searchOmega = 0, searchApproximation = 0;
+        // classes whose weight differs from the tree's or that it lacks, and their weights
+        std::vector<unsigned int> detachedClasses;
+        std::vector<WeightsPerBone> detachedWeights;
+    };
+}
+
+#endif //CORCALCULATOR_WEIGHTNEIGHBOURINDEX_H
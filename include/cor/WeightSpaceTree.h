@@ -0,0 +1,64 @@
+#ifndef CORCALCULATOR_WEIGHTSPACETREE_H
+#define CORCALCULATOR_WEIGHTSPACETREE_H
+
+#include <vector>
+
+#include "CoRTriangleStore.h"
+#include "WeightsPerBone.h"
+
+namespace CoR {
+    /**
+     * Binary tree clustering the triangle store entries in weight space, for the
+     * Barnes-Hut style integral of HierarchicalCoRCalculator. Every node keeps
+     * the summed area and area-weighted centers of its entries and, per bone any
+     * of them is influenced by, the range of their weights (0 if an entry lacks
+     * the bone). Inner nodes split at the median weight of their widest bone.
+     */
+    struct WeightSpaceTree {
+        struct Node {
+            // entries[first .. first + count)
+            unsigned int first, count;
+            // children are nodes[children] and nodes[children + 1], 0 for a leaf
+            unsigned int children;
+            // boundBones/Min/Max[boundsBegin .. boundsEnd), sorted by bone
+            unsigned int boundsBegin, boundsEnd;
+            float area;
+            // sum of area * center
+            float momentX, momentY, momentZ;
+
+            bool leaf() const {
+                return children == 0;
+            }
+        };
+
+        std::vector<Node> nodes;
+        std::vector<unsigned int> entries;
+        // index of every store entry in entries
+        std::vector<unsigned int> positions;
+        std::vector<unsigned short> boundBones;
+        std::vector<float> boundMin;
+        std::vector<float> boundMax;
+
+        void build(const CoRTriangleStore &store, unsigned int leafSize = 32);
+
+        /**
+         * Recomputes the nodes above changedEntries, whose weights or areas changed
+         * in store, without moving entries between nodes. The bounds stay exact,
+         * only the splits may fit the new weights less well than a rebuild would.
+         */
+        void refit(const CoRTriangleStore &store, const std::vector<unsigned int> &changedEntries);
+
+        bool empty() const {
+            return nodes.empty();
+        }
+
+        /**
+         * Bounds of similarity(a, w, sigma) over all weights a inside the ranges of
+         * node. A pair term exp(-d^2 / sigma^2) with d = a_j w_k - a_k w_j is bounded
+         * by the interval of d over the box of a_j and a_k.
+         */
+        void similarityBounds(const Node &node, const WeightsPerBone &w, float sigma, float &lower, float &upper) const;
+    };
+}
+
+#endif //CORCALCULATOR_WEIGHTSPACETREE_H
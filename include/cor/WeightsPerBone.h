@@ -7,8 +7,13 @@
 
 #include <vector>
 #include <cmath>
+#include <cstddef>
 
-#define COR_ENABLE_PROFILING
+// Maximum number of nonzero bone influences stored per weight. Triangle averages
+// combine three vertices, so this should be about three times the per-vertex limit.
+#ifndef COR_MAX_BONE_INFLUENCES
+#define COR_MAX_BONE_INFLUENCES 16
+#endif
 
 namespace CoR {
     struct WeightsPerBone;
@@ -16,53 +21,86 @@ namespace CoR {
     float skinningWeightsDistance(const WeightsPerBone &wp, const WeightsPerBone &wv);
     float similarity(const WeightsPerBone &wp, const WeightsPerBone &wv, float sigma);
 
+    /**
+     * Sparse skinning weights: the nonzero (bone, weight) pairs sorted by bone id
+     * in fixed-size inline storage, so copies and arithmetic never allocate.
+     * If an operation yields more than Capacity influences, the ones with the
+     * smallest magnitude are dropped.
+     */
     struct WeightsPerBone {
-        std::vector<float> weights;
+        static const int Capacity = COR_MAX_BONE_INFLUENCES;
 
-        WeightsPerBone() = default;
-        explicit WeightsPerBone(unsigned long n) {
-            weights = std::vector<float>(n, 0);
-        }
+        unsigned short bones[Capacity];
+        float weights[Capacity];
+        int count;
 
-        unsigned long size() const {
-            return weights.size();
-        }
+        WeightsPerBone() : count(0) {}
 
-        float & operator[](int idx) {
-            return weights[idx];
+        // number of nonzero influences
+        int size() const {
+            return count;
         }
 
-        float operator[](int idx) const {
-            return weights[idx];
+        unsigned int bone(int i) const {
+            return bones[i];
         }
 
-        WeightsPerBone operator + (const WeightsPerBone &other) const {
-            WeightsPerBone sum(size());
-            for (int i = 0; i < size(); ++i)
-                sum.weights[i] = weights[i] + other.weights[i];
-            return sum;
+        float weight(int i) const {
+            return weights[i];
         }
 
-        WeightsPerBone operator - (const WeightsPerBone &other) const {
-            WeightsPerBone dif(size());
-            for (int i = 0; i < size(); ++i)
-                dif.weights[i] = weights[i] - other.weights[i];
-            return dif;
+        // weight of the given bone, 0 if it has no influence
+        float operator[](unsigned int bone) const {
+            for (int i = 0; i < count && bones[i] <= bone; ++i)
+                if (bones[i] == bone)
+                    return weights[i];
+            return 0;
         }
 
+        void set(unsigned int bone, float weight);
+
+        WeightsPerBone operator + (const WeightsPerBone &other) const;
+        WeightsPerBone operator - (const WeightsPerBone &other) const;
+
         WeightsPerBone operator * (const float scalar) const {
-            WeightsPerBone ret(size());
-            for (int i = 0; i < size(); ++i)
-                ret.weights[i] = weights[i] * scalar;
+            WeightsPerBone ret = *this;
+            for (int i = 0; i < count; ++i)
+                ret.weights[i] *= scalar;
             return ret;
         }
 
         float norm() const {
             float norm = 0;
-            for (int i = 0; i < size(); ++i)
+            for (int i = 0; i < count; ++i)
                 norm += weights[i] * weights[i];
             return std::sqrt(norm);
         }
+
+        // exact equality of the influences
+        bool operator == (const WeightsPerBone &other) const {
+            if (count != other.count)
+                return false;
+            for (int i = 0; i < count; ++i)
+                if (bones[i] != other.bones[i] || weights[i] != other.weights[i])
+                    return false;
+            return true;
+        }
+
+        bool operator != (const WeightsPerBone &other) const {
+            return !(*this == other);
+        }
+
+        std::size_t hash() const;
+
+        // hash() as the hasher of unordered containers
+        struct Hasher {
+            std::size_t operator()(const WeightsPerBone &weights) const {
+                return weights.hash();
+            }
+        };
+
+        // builds weights from n <= 2 * Capacity pairs sorted by bone id, keeping the Capacity largest
+        static WeightsPerBone fromSorted(const unsigned short *bones, const float *weights, int n);
     };
 }
 
@@ -4,6 +4,7 @@
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cor/CoRFile.h>
 
 static const int MAX_INFLUENCES = 4;
 
@@ -49,6 +50,16 @@ public:
     std::vector<VertexSkinData> skinInfo;
     std::vector<SkeletonBone> cpuSkeleton;
 
+    // CoRs read in place, e.g. from a MappedCoRFile kept open until initBuffers; used instead of
+    // centersOfRotation while set, flattenVertices gathers them into centersOfRotation
+    CoR::CoRSpan corSource;
+
+    // upload the CoRs as normalized 16 bit integers over their bounding box instead of floats, 6 bytes
+    // a cor instead of 12; costs no further precision for cors read from a Quantized16 file
+    bool quantizeCoRs = false;
+    // set by initBuffers: cor = corOrigin + corExtent * attribute
+    glm::vec3 corOrigin = glm::vec3(0.0f), corExtent = glm::vec3(1.0f);
+
     // GPU handles
     GLuint vao;
     GLuint vboPos, vboNorm, vboUV, ebo;
@@ -58,6 +69,7 @@ public:
     void draw() const;
 
     void uploadSkeletonUniforms(GLuint skinProg, const std::vector<glm::mat4>& boneMatrices, const std::vector<DualQuaternion>& boneDualQuats);
+    void uploadCoRUniforms(GLuint skinProg) const;
 
     void flattenVertices();
 };
@@ -64,7 +64,7 @@ int main(int argc, char** argv) {
         /*sigma*/0.1f,
         /*omega*/0.1f,
         /*performSubdivision*/false,
-        /*numThreads*/8,
+        /*numThreads, 0: shared pool*/0,
         /*subdivEpsilon*/0.5f,
         /*useBFS*/true
     );
@@ -74,11 +74,11 @@ int main(int argc, char** argv) {
     corProc.ComputeCoRsAsync( meshData, skelData.numberOfBones, nullptr );
 #endif
 
-    // Load the precomputed cors
+    // Map the precomputed cors, they stay mapped in corProc until the buffers are uploaded
     std::string corsFile = projDir + R"(\cor_output\output_file.cors)";
-    auto cors = corProc.LoadCoRsFromBinaryFile(corsFile);
+    CoR::CoRSpan cors = corProc.MapCoRsFromBinaryFile(corsFile, /*verifyChecksum*/false);
 
-    if (cors.size() != meshData.vertices.size()) {
+    if (cors.size != meshData.vertices.size()) {
         std::cerr << "ERROR: mismatched CoR count\n";
         return -1;
     }
@@ -89,7 +89,9 @@ int main(int argc, char** argv) {
     mesh.normals = meshData.normals;
     mesh.uvs = meshData.uvs;
     mesh.indices = meshData.faces;
-    mesh.centersOfRotation = cors;
+    mesh.corSource = cors;
+    // quantized files are uploaded quantized as well
+    mesh.quantizeCoRs = corProc.MappedCoREncoding() == CoR::CoREncoding::Quantized16;
 
     mesh.skinInfo.resize(mesh.positions.size());
     for (size_t i = 0; i < mesh.positions.size(); ++i) {
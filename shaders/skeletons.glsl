@@ -8,6 +8,10 @@ layout (location = 4) in vec4 SkeletonBoneIndices;
 layout (location = 5) in vec4 SkeletonBoneWeights;
 layout (location = 6) in vec3 centerOfRotation;
 
+// the attribute is normalized over the CoR bounding box when the mesh quantizes its CoRs
+uniform vec3 uCoROrigin = vec3(0.0);
+uniform vec3 uCoRExtent = vec3(1.0);
+
 struct SkeletonBone {
 	vec3 pos;
 	mat4 transform;
@@ -34,9 +38,10 @@ mat4 perform_skinning()
 	//	return mat4(1.0);
 
 	mat4 result = mat4(0);
+	vec3 center = uCoROrigin + uCoRExtent * centerOfRotation;
 
 #ifdef SKELETAL_ANIMATION_CRS_OUT
-	cor = centerOfRotation;
+	cor = center;
 #endif
 
 	if (SkinningMode == SKELETAL_ANIMATION_MODE_DQS) {
@@ -62,7 +67,7 @@ mat4 perform_skinning()
 		quatRotation = normalize(quatRotation);
 		mat3 quatRotationMatrix = quat_toRotationMatrix(quatRotation);
 
-		vec4 translation = vec4((lbs*vec4(centerOfRotation, 1.0) - vec4(quatRotationMatrix*centerOfRotation, 0.0)).xyz, 1.0);
+		vec4 translation = vec4((lbs*vec4(center, 1.0) - vec4(quatRotationMatrix*center, 0.0)).xyz, 1.0);
 
 		result = mat4(quatRotationMatrix);
 		result[3] = translation;
@@ -73,6 +73,10 @@ layout (location = 4) in ivec4 SkeletonBoneIndices;
 layout (location = 5) in vec4 SkeletonBoneWeights;
 layout (location = 6) in vec3 centerOfRotation;
 
+// the attribute is normalized over the CoR bounding box when the mesh quantizes its CoRs
+uniform vec3 uCoROrigin = vec3(0.0);
+uniform vec3 uCoRExtent = vec3(1.0);
+
 struct SkeletonBone {
     vec3            pos;
     mat4            transform;
@@ -127,8 +131,9 @@ mat4 perform_skinning_crs()
     quatRotation = normalize(quatRotation);
     mat3 R        = quat_toRotationMatrix(quatRotation);
 
-    vec3 corLBS = (lbs * vec4(centerOfRotation, 1.0)).xyz;
-    vec3 corRot = R * centerOfRotation;
+    vec3 center = uCoROrigin + uCoRExtent * centerOfRotation;
+    vec3 corLBS = (lbs * vec4(center, 1.0)).xyz;
+    vec3 corRot = R * center;
     vec4 trans  = vec4(corLBS - corRot, 1.0);
 
     mat4 skinMat = mat4(R);
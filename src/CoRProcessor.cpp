@@ -1,12 +1,15 @@
 #include "CoRProcessor.h"
 
+#include <iostream>
+
 CoRProcessor::CoRProcessor(float sigma,
     float omega,
     bool performSubdivision,
     unsigned int numThreads,
     float subdivEpsilon,
     bool useBFS,
-    float bfsEpsilon)
+    float bfsEpsilon,
+    bool aggregateTriangles)
     : sigma_(sigma)
     , omega_(omega)
     , performSubdivision_(performSubdivision)
@@ -14,6 +17,7 @@ CoRProcessor::CoRProcessor(float sigma,
     , subdivEpsilon_(subdivEpsilon)
     , useBFS_(useBFS)
     , bfsEpsilon_(bfsEpsilon)
+    , aggregateTriangles_(aggregateTriangles)
 {
     // Instantiate the appropriate calculator
     if (useBFS_) {
@@ -22,31 +26,49 @@ CoRProcessor::CoRProcessor(float sigma,
     }
     else {
         calc_ = std::make_unique<CoR::CoRCalculator>(
-            sigma_, omega_, performSubdivision_, numThreads_);
+            sigma_, omega_, performSubdivision_, numThreads_, aggregateTriangles_);
     }
 }
 
-void CoRProcessor::ComputeCoRsAsync(const FBXLoader::FBXMeshData& mesh, unsigned int numBones, std::function<void(std::vector<glm::vec3>&)> callback)
+std::shared_ptr<CoR::CoRJob> CoRProcessor::ComputeCoRsAsync(const FBXLoader::FBXMeshData& mesh, unsigned int numBones, std::function<void(std::vector<glm::vec3>&)> callback)
 {
     // Choose calculator
     auto& calculator = useBFS_ ? static_cast<CoR::CoRCalculator&>(*bfsCalc_) : *calc_;
 
     // Weight conversion and mesh creation
     std::vector<CoR::WeightsPerBone> weightsPerBone = calculator.convertWeights(numBones, mesh.boneIndices, mesh.boneWeights);
-    CoR::CoRMesh corMesh = calculator.createCoRMesh(mesh.vertices, mesh.faces, weightsPerBone, subdivEpsilon_);
+    CoR::CoRMesh corMesh = calculator.createCoRMesh(
+        std::vector<glm::vec3>(mesh.vertices), std::vector<unsigned int>(mesh.faces), std::move(weightsPerBone), subdivEpsilon_);
 
     // Async compute with user callback
-    calculator.calculateCoRsAsync(corMesh, [this, callback](std::vector<glm::vec3>& cors) {
+    return calculator.calculateCoRsAsync(corMesh, [this, callback](std::vector<glm::vec3>& cors) {
         this->saveCoRsToBinaryFile("../cor_output/bfs_cs.cors", cors);
         this->saveCoRsToTextFile("../cor_output/bfs_cs.txt", cors);
+        if (callback)
+            callback(cors);
         });
 }
 
 std::vector<glm::vec3> CoRProcessor::LoadCoRsFromBinaryFile(
-    const std::string& filepath) const
+    const std::string& filepath, bool verifyChecksum) const
 {
     auto& calculator = useBFS_ ? static_cast<CoR::CoRCalculator&>(*bfsCalc_) : *calc_;
-    return calculator.loadCoRsFromBinaryFile(filepath);
+    return calculator.loadCoRsFromBinaryFile(filepath, verifyChecksum);
+}
+
+CoR::CoRSpan CoRProcessor::MapCoRsFromBinaryFile(const std::string& filepath, bool verifyChecksum)
+{
+    std::string error;
+    if (!corFile_.open(filepath, verifyChecksum, &error)) {
+        std::cerr << "Error: Cannot load cors from " << filepath << ": " << error << std::endl;
+        return CoR::CoRSpan();
+    }
+    return corFile_.cors();
+}
+
+CoR::CoREncoding CoRProcessor::MappedCoREncoding() const
+{
+    return corFile_.encoding();
 }
 
 void CoRProcessor::saveCoRsToBinaryFile(const std::string& filepath, std::vector<glm::vec3>& cors) const
@@ -0,0 +1,131 @@
+#include <cor/BonePairIndex.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace CoR {
+    namespace {
+        std::uint32_t pairKey(unsigned int j, unsigned int k)
+        {
+            return (j << 16) | k;
+        }
+
+        struct Record {
+            std::uint32_t pair;
+            float radius;
+            float angle;
+            unsigned int entry;
+        };
+    }
+
+    void BonePairIndex::build(const CoRTriangleStore &store, ThreadPool *pool)
+    {
+        const unsigned long entryCount = store.size();
+
+        // one record per entry and pair of its bones, counted first to fill in parallel
+        std::vector<unsigned long> recordOffsets(entryCount + 1, 0);
+        for (unsigned long t = 0; t < entryCount; ++t) {
+            unsigned long n = store.weightOffsets[t + 1] - store.weightOffsets[t];
+            recordOffsets[t + 1] = recordOffsets[t] + (n > 1 ? n * (n - 1) / 2 : 0);
+        }
+
+        std::vector<Record> records(recordOffsets.back());
+        auto fill = [&](unsigned long from, unsigned long to) {
+            for (unsigned long t = from; t < to; ++t) {
+                unsigned int begin = store.weightOffsets[t], end = store.weightOffsets[t + 1];
+                Record *out = records.data() + recordOffsets[t];
+                for (unsigned int j = begin; j < end; ++j) {
+                    for (unsigned int k = j + 1; k < end; ++k) {
+                        float aj = store.weightValues[j], ak = store.weightValues[k];
+                        *out++ = Record{pairKey(store.weightBones[j], store.weightBones[k]), std::sqrt(aj * aj + ak * ak), std::atan2(ak, aj), static_cast<unsigned int>(t)};
+                    }
+                }
+            }
+        };
+        if (pool)
+            pool->parallelFor(0, entryCount, 0, fill);
+        else
+            fill(0, entryCount);
+
+        std::sort(records.begin(), records.end(), [](const Record &a, const Record &b) {
+            return a.pair != b.pair ? a.pair < b.pair : a.radius < b.radius;
+        });
+
+        pairs.clear();
+        unindexed.clear();
+        pairBuckets.assign(1, 0);
+        bucketOffsets.assign(1, 0);
+        bucketMinRadius.clear();
+        angles.resize(records.size());
+        entries.resize(records.size());
+
+        for (std::size_t first = 0; first < records.size();) {
+            std::size_t last = first;
+            while (last < records.size() && records[last].pair == records[first].pair)
+                ++last;
+
+            // radius quantiles, each sorted by angle
+            std::size_t count = last - first;
+            std::size_t buckets = std::min<std::size_t>(BucketsPerPair, count);
+            for (std::size_t b = 0; b < buckets; ++b) {
+                std::size_t bucketBegin = first + count * b / buckets;
+                std::size_t bucketEnd = first + count * (b + 1) / buckets;
+                bucketMinRadius.push_back(records[bucketBegin].radius);
+                std::sort(records.begin() + bucketBegin, records.begin() + bucketEnd, [](const Record &a, const Record &c) {
+                    return a.angle < c.angle;
+                });
+                for (std::size_t r = bucketBegin; r < bucketEnd; ++r) {
+                    angles[r] = records[r].angle;
+                    entries[r] = records[r].entry;
+                }
+                bucketOffsets.push_back(static_cast<unsigned int>(bucketEnd));
+            }
+
+            pairs.push_back(records[first].pair);
+            pairBuckets.push_back(static_cast<unsigned int>(bucketMinRadius.size()));
+            first = last;
+        }
+    }
+
+    void BonePairIndex::addUnindexed(const std::vector<unsigned int> &changed)
+    {
+        std::vector<unsigned int> merged;
+        merged.reserve(unindexed.size() + changed.size());
+        std::set_union(unindexed.begin(), unindexed.end(), changed.begin(), changed.end(), std::back_inserter(merged));
+        unindexed.swap(merged);
+    }
+
+    void BonePairIndex::query(const WeightsPerBone &w, float radius, std::vector<unsigned int> &candidates) const
+    {
+        for (int j = 0; j < w.size(); ++j) {
+            for (int k = j + 1; k < w.size(); ++k) {
+                auto pair = std::lower_bound(pairs.begin(), pairs.end(), pairKey(w.bone(j), w.bone(k)));
+                if (pair == pairs.end() || *pair != pairKey(w.bone(j), w.bone(k)))
+                    continue;
+                std::size_t p = pair - pairs.begin();
+
+                float bj = w.weight(j), bk = w.weight(k);
+                float vertexRadius = std::sqrt(bj * bj + bk * bk);
+                float vertexAngle = std::atan2(bk, bj);
+
+                for (unsigned int b = pairBuckets[p]; b < pairBuckets[p + 1]; ++b) {
+                    auto first = angles.begin() + bucketOffsets[b];
+                    auto last = angles.begin() + bucketOffsets[b + 1];
+
+                    // |sin(dtheta)| <= radius / (|a| |b|) for the smallest |a| of the bucket
+                    float sine = radius / (bucketMinRadius[b] * vertexRadius);
+                    if (sine < 1.0f) {
+                        // weights are positive, so both angles lie in [0, pi/2] and asin bounds dtheta
+                        float window = std::asin(sine) * (1.0f + 1e-6f) + 1e-7f;
+                        first = std::lower_bound(first, last, vertexAngle - window);
+                        last = std::upper_bound(first, last, vertexAngle + window);
+                    }
+                    for (auto a = first; a != last; ++a)
+                        candidates.push_back(entries[a - angles.begin()]);
+                }
+            }
+        }
+        candidates.insert(candidates.end(), unindexed.begin(), unindexed.end());
+    }
+}
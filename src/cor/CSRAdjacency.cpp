@@ -0,0 +1,109 @@
+#include <cor/CSRAdjacency.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace CoR {
+    void CSRAdjacency::buildVertexTriangles(const std::vector<CoRTriangle> &triangles, unsigned long vertexCount)
+    {
+        offsets.assign(vertexCount + 1, 0);
+        for (const CoRTriangle &t : triangles) {
+            ++offsets[t.alpha + 1];
+            ++offsets[t.beta + 1];
+            ++offsets[t.gamma + 1];
+        }
+        for (unsigned long v = 0; v < vertexCount; ++v)
+            offsets[v + 1] += offsets[v];
+
+        indices.resize(offsets.back());
+        std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+        for (unsigned long i = 0; i < triangles.size(); ++i) {
+            const CoRTriangle &t = triangles[i];
+            indices[next[t.alpha]++] = static_cast<unsigned int>(i);
+            indices[next[t.beta]++] = static_cast<unsigned int>(i);
+            indices[next[t.gamma]++] = static_cast<unsigned int>(i);
+        }
+    }
+
+    EdgeStatistics CSRAdjacency::buildTriangleNeighbours(const std::vector<CoRTriangle> &triangles, unsigned long vertexCount)
+    {
+        const unsigned long triangleCount = triangles.size();
+        EdgeStatistics statistics;
+
+        // bucket the edge sides (upper vertex, triangle) by their lower vertex
+        std::vector<unsigned int> edgeOffsets(vertexCount + 1, 0);
+        for (const CoRTriangle &t : triangles)
+            for (int i = 0; i < 3; ++i)
+                if (t[i] != t[(i + 1) % 3])
+                    ++edgeOffsets[std::min(t[i], t[(i + 1) % 3]) + 1];
+        for (unsigned long v = 0; v < vertexCount; ++v)
+            edgeOffsets[v + 1] += edgeOffsets[v];
+
+        std::vector<std::pair<unsigned int, unsigned int>> sides(edgeOffsets.back());
+        std::vector<unsigned int> next(edgeOffsets.begin(), edgeOffsets.end() - 1);
+        for (unsigned long i = 0; i < triangleCount; ++i) {
+            const CoRTriangle &t = triangles[i];
+            for (int j = 0; j < 3; ++j) {
+                int a = t[j], b = t[(j + 1) % 3];
+                if (a != b)
+                    sides[next[std::min(a, b)]++] = std::make_pair(static_cast<unsigned int>(std::max(a, b)), static_cast<unsigned int>(i));
+            }
+        }
+
+        // calls link(t0, t1) for both orders of every pair of triangles sharing an edge
+        auto forEachEdge = [&](bool count, const std::function<void(unsigned int, unsigned int)> &link) {
+            for (unsigned long v = 0; v < vertexCount; ++v) {
+                for (unsigned int first = edgeOffsets[v]; first < edgeOffsets[v + 1];) {
+                    unsigned int last = first + 1;
+                    while (last < edgeOffsets[v + 1] && sides[last].first == sides[first].first)
+                        ++last;
+
+                    if (count) {
+                        ++statistics.edges;
+                        if (last - first == 1)
+                            ++statistics.boundaryEdges;
+                        else if (last - first > 2)
+                            ++statistics.nonManifoldEdges;
+                    }
+                    for (unsigned int i = first; i < last; ++i)
+                        for (unsigned int j = first; j < last; ++j)
+                            if (sides[i].second != sides[j].second)
+                                link(sides[i].second, sides[j].second);
+                    first = last;
+                }
+            }
+        };
+
+        for (unsigned long v = 0; v < vertexCount; ++v)
+            std::sort(sides.begin() + edgeOffsets[v], sides.begin() + edgeOffsets[v + 1]);
+
+        offsets.assign(triangleCount + 1, 0);
+        forEachEdge(true, [this](unsigned int t0, unsigned int) {
+            ++offsets[t0 + 1];
+        });
+        for (unsigned long t = 0; t < triangleCount; ++t)
+            offsets[t + 1] += offsets[t];
+
+        indices.resize(offsets.back());
+        next.assign(offsets.begin(), offsets.end() - 1);
+        forEachEdge(false, [this, &next](unsigned int t0, unsigned int t1) {
+            indices[next[t0]++] = t1;
+        });
+
+        // triangles sharing more than one edge (duplicates, folds) are linked once
+        unsigned int write = 0;
+        for (unsigned long t = 0; t < triangleCount; ++t) {
+            auto first = indices.begin() + offsets[t];
+            auto last = indices.begin() + offsets[t + 1];
+            std::sort(first, last);
+            last = std::unique(first, last);
+            offsets[t] = write;
+            write = static_cast<unsigned int>(std::copy(first, last, indices.begin() + write) - indices.begin());
+        }
+        offsets[triangleCount] = write;
+        indices.resize(write);
+
+        return statistics;
+    }
+}
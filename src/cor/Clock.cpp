@@ -12,8 +12,13 @@ namespace CoR {
     }
 
     void Clock::clockMessageAtCurrentTime(const std::string & message) const
+    {
+        std::cout << message << " [" << elapsedSeconds() << " s]" << std::endl;
+    }
+
+    double Clock::elapsedSeconds() const
     {
         std::chrono::duration<double> dt = std::chrono::high_resolution_clock::now() - StartTime;
-        std::cout << message << " [" << dt.count() << " s]" << std::endl;
+        return dt.count();
     }
 }
\ No newline at end of file
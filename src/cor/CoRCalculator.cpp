@@ -6,23 +6,43 @@ Author      :   Paul Maximilian Bittner
 #include <fstream>
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <future>
+#include <unordered_map>
+#include <unordered_set>
 
-#include <map>
 
 #include <glm/glm.hpp>
 #include <cor/CoRCalculator.h>
 #include <cor/CoRTriangle.h>
 #include <cor/CoRMesh.h>
 #include <cor/Clock.h>
+#include <cor/CoRCheckpoint.h>
+#include <cor/CoRFile.h>
+#include <cor/CoRShard.h>
+#include <cor/CoRJob.h>
+#include <cor/MeshSubdivider.h>
+#include <cor/SimilarityKernel.h>
 
 namespace CoR {
 	CoRCalculator::CoRCalculator(
 			float sigma,
 			float omega,
 			bool subdivide,
-			unsigned int numberOfThreadsToCreate)
-			: _sigma(sigma), _omega(omega), _subdivide(subdivide), _numThreads(numberOfThreadsToCreate)
+			unsigned int numberOfThreadsToCreate,
+			bool aggregateTriangles)
+			: _pool(numberOfThreadsToCreate == 0 ? ThreadPool::shared() : std::make_shared<ThreadPool>(numberOfThreadsToCreate)), _sigma(sigma), _omega(omega), _numThreads(numberOfThreadsToCreate), _subdivide(subdivide), _aggregateTriangles(aggregateTriangles)
+	{
+	}
+
+	CoRCalculator::CoRCalculator(
+			const std::shared_ptr<ThreadPool> & pool,
+			float sigma,
+			float omega,
+			bool subdivide,
+			bool aggregateTriangles)
+			: _pool(pool ? pool : ThreadPool::shared()), _sigma(sigma), _omega(omega), _numThreads(_pool->size()), _subdivide(subdivide), _aggregateTriangles(aggregateTriangles)
 	{
 	}
 
@@ -31,7 +51,7 @@ namespace CoR {
 			const std::vector<std::vector<unsigned int>>& skeletonBoneIndices,
 			const std::vector<std::vector<float>>& skeletonBoneWeights) const
 	{
-		std::vector<WeightsPerBone> weights(skeletonBoneWeights.size(), WeightsPerBone(numBones));
+		std::vector<WeightsPerBone> weights(skeletonBoneWeights.size(), WeightsPerBone());
 
 #ifdef COR_ENABLE_PROFILING
 		std::cout << "Skeleton Bone Weights Size: " << skeletonBoneWeights.size() << "\n";
@@ -49,31 +69,120 @@ namespace CoR {
 			WeightsPerBone &weightsToSet = weights[i];
 
 			for (int weightIndex = 0; weightIndex < indices.size(); ++weightIndex) {
-				int boneIndex = indices[weightIndex];
-				weightsToSet[boneIndex] = weightsToConvert[weightIndex];
+				unsigned int boneIndex = indices[weightIndex];
+				if (boneIndex < numBones)
+					weightsToSet.set(boneIndex, weightsToConvert[weightIndex]);
 			}
 		}
 
 		return weights;
 	}
 
-	bool CoRCalculator::calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut) const
+	void CoRCalculator::finishStage(const std::string & name, const Clock & clock) const
 	{
+		double seconds = clock.elapsedSeconds();
+		_stats.setStage(name, seconds);
 #ifdef COR_ENABLE_PROFILING
+		std::cout << "\t" << name << " took [" << seconds << " s]" << std::endl;
 #endif
-		WeightsPerBone weight = mesh.weights[vertex];
+	}
+
+	namespace {
+		// per-thread triangle set reused across vertices, so neither the BFS nor the pruned sum allocates
+		struct BFSScratch {
+			// a triangle is queued in the current traversal iff visited[t] == epoch
+			std::vector<unsigned int> visited;
+			unsigned int epoch = 0;
+			std::vector<unsigned int> queue;
+
+			void begin(unsigned long triangleCount) {
+				if (visited.size() < triangleCount)
+					visited.resize(triangleCount, 0);
+				if (++epoch == 0) {
+					std::fill(visited.begin(), visited.end(), 0);
+					epoch = 1;
+				}
+				queue.clear();
+			}
+
+			void push(unsigned int t) {
+				if (visited[t] != epoch) {
+					visited[t] = epoch;
+					queue.push_back(t);
+				}
+			}
+		};
+
+		thread_local BFSScratch bfsScratch;
+		// candidates reported by the bone pair index, with duplicates
+		thread_local std::vector<unsigned int> pairCandidates;
+		thread_local BFSScratch candidateScratch;
+	}
+
+	bool CoRCalculator::calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut) const
+	{
+		CoRCounters counters;
+		return calculateCoR(vertex, mesh, corOut, counters);
+	}
+
+	bool CoRCalculator::calculateCoR(unsigned long vertex, const CoRMesh &mesh, glm::vec3* corOut, CoRCounters &counters) const
+	{
+		SimilarityKernel kernel(_sigma, mesh.maxInfluences);
+		kernel.setVertex(mesh.weights[vertex]);
 
 		glm::vec3 numerator(0);
 		float denominator = 0;
 
-		for (const CoRTriangle &t : mesh.triangles) {
-#ifdef COR_ENABLE_PROFILING
-#endif
-			float sim = similarity(weight, t.averageWeight, _sigma);
+		const CoRTriangleStore &store = mesh.triangleStore;
+		float sims[SimilarityKernel::BatchSize];
+
+		const unsigned long triangleCount = store.size();
+		if (_similarityCutoff > 0 && !mesh.bonePairs.empty()) {
+			// only the entries with a shared bone pair inside the cutoff window, in store order
+			pairCandidates.clear();
+			mesh.bonePairs.query(mesh.weights[vertex], _sigma * std::sqrt(-std::log(_similarityCutoff)), pairCandidates);
+
+			// the epoch test-and-set keeps every entry once, sorting the short list restores store order
+			candidateScratch.begin(triangleCount);
+			for (unsigned int t : pairCandidates)
+				candidateScratch.push(t);
+			std::vector<unsigned int> &candidates = candidateScratch.queue;
+			std::sort(candidates.begin(), candidates.end());
+
+			const unsigned int candidateCount = static_cast<unsigned int>(candidates.size());
+			for (unsigned int first = 0; first < candidateCount; first += SimilarityKernel::BatchSize) {
+				unsigned int lanes = std::min<unsigned int>(SimilarityKernel::BatchSize, candidateCount - first);
+				kernel.evaluateIndexed(store, candidates.data() + first, lanes, sims);
+
+				for (unsigned int l = 0; l < lanes; ++l) {
+					unsigned int t = candidates[first + l];
+					float areaTimesSim = store.area[t] * sims[l];
+					numerator.x += areaTimesSim * store.centerX[t];
+					numerator.y += areaTimesSim * store.centerY[t];
+					numerator.z += areaTimesSim * store.centerZ[t];
+					denominator += areaTimesSim;
+				}
+			}
 
-			float areaTimesSim = t.area*sim;
-			numerator += areaTimesSim * t.center;
-			denominator += areaTimesSim;
+			counters.similarityEvaluations += candidateCount;
+			counters.trianglesVisited += candidateCount;
+			counters.trianglesPruned += triangleCount - candidateCount;
+		} else {
+			for (unsigned long first = 0; first < triangleCount; first += SimilarityKernel::BatchSize) {
+				int lanes = static_cast<int>(std::min<unsigned long>(SimilarityKernel::BatchSize, triangleCount - first));
+				kernel.evaluate(store, first, lanes, sims);
+
+				for (int l = 0; l < lanes; ++l) {
+					float areaTimesSim = store.area[first + l] * sims[l];
+					numerator.x += areaTimesSim * store.centerX[first + l];
+					numerator.y += areaTimesSim * store.centerY[first + l];
+					numerator.z += areaTimesSim * store.centerZ[first + l];
+					denominator += areaTimesSim;
+				}
+			}
+
+			counters.similarityEvaluations += triangleCount;
+			counters.trianglesVisited += triangleCount;
 		}
 
 		//p_i^*
@@ -88,71 +197,255 @@ namespace CoR {
 
 	void CoRCalculator::calculateCoRs_Interval(unsigned long from, unsigned long to, const CoRMesh& mesh, std::vector<glm::vec3>& cors) const 
 	{
-		for (unsigned long i = from; i < to; ++i) {
-			calculateCoR(i, mesh, cors.data() + i);
+		CoRCounters counters;
+		for (unsigned long i = from; i < to; ++i)
+			calculateCoR(i, mesh, cors.data() + i, counters);
+		counters.cors += to - from;
+		_stats.add(counters);
+	}
 
-#ifdef COR_ENABLE_PROFILING
-			const unsigned long total = to - from;
-			unsigned long done = i - from;
-			if (done > 0 && done % 1 == 0) {
-				float pct = 100.0f * done / float(total);
-				std::cout << "[Thread " << (from / total) << "] " << done << "/" << total << " vertices (" << pct << "%)" << std::endl;
-			}
-#endif
-		}
+	void CoRCalculator::calculateWeightClassCoRs_Interval(unsigned long from, unsigned long to, const CoRMesh& mesh, const WeightClasses& classes, std::vector<glm::vec3>& classCors) const
+	{
+		CoRCounters counters;
+		for (unsigned long c = from; c < to; ++c)
+			if (classes.count(c) > 0)
+				calculateCoR(classes.representative(c), mesh, classCors.data() + c, counters);
+		counters.cors += to - from;
+		_stats.add(counters);
 	}
 
-	void CoRCalculator::calculateCoRsAsync(const CoRMesh & mesh, const std::function<void(std::vector<glm::vec3>&)> & callback)
+	std::shared_ptr<CoRJob> CoRCalculator::calculateCoRsAsync(const CoRMesh & mesh, const std::function<void(std::vector<glm::vec3>&)> & callback)
 	{
-		_worker = std::async([this, mesh, callback]
+		std::shared_ptr<CoRJob> job = std::make_shared<CoRJob>(mesh.vertices.size());
+		_worker = std::async(std::launch::async, [this, mesh, callback, job]
 		{
-			using namespace std::chrono;
+			// waiters are released however the bake ends
+			struct FinishJob {
+				CoRJob &job;
+				~FinishJob() {
+					job.finish();
+				}
+			} finishJob{*job};
 
-#ifdef COR_ENABLE_PROFILING
 			Clock globalClock;
 			globalClock.clockStart();
-#endif
+			_stats.resetCounters();
 
 			unsigned long vertexCount = mesh.vertices.size();
 
-			// calculate CoRs
-			std::vector<glm::vec3> cors(vertexCount, glm::vec3(0));
-			{
-				std::vector<std::future<void>> threads;
-				auto intervall = static_cast<unsigned long>(std::ceil(static_cast<double>(vertexCount) / static_cast<double>(_numThreads)));
+			// the cor only depends on the skinning weight, so compute it once per weight class
+			WeightClasses localClasses;
+			const WeightClasses *classes = &weightClassesOf(mesh, localClasses);
+			unsigned long classCount = classes->size();
+			_stats.setSizes(vertexCount, classCount);
 
 #ifdef COR_ENABLE_PROFILING
-				std::cout << "Starting " << _numThreads << " threads with intervall = " << intervall << std::endl;
+			std::cout << "CoR cache: " << classCount << " misses, " << vertexCount - classCount << " hits ("
+					  << classCount << " distinct weights for " << vertexCount << " vertices)" << std::endl;
 #endif
 
-				for (unsigned long from = 0; from < vertexCount; from += intervall) {
-					unsigned long to = std::min(from + intervall, vertexCount);
-					threads.push_back(
-							std::async(std::launch::async, &CoR::CoRCalculator::calculateCoRs_Interval, this, from, to, std::ref(mesh), std::ref(cors))
-							);
-				}
-			} // End of scrope destroys vector of threads, whose destructors force us to wait until they finished execution
+			// calculate CoRs
+			std::vector<glm::vec3> classCors(classCount, glm::vec3(0));
 
 #ifdef COR_ENABLE_PROFILING
-			globalClock.clockMessageAtCurrentTime("Whole computation took");
+			std::cout << "Computing " << classCount << " CoRs on " << _pool->size() << " workers"
+					  << " (similarity kernel: " << SimilarityKernel::instructionSet() << ", "
+					  << SimilarityKernel::specialization(mesh.maxInfluences) << " influences)" << std::endl;
 #endif
 
-			callback(cors);
+			_pool->parallelFor(0, classCount, 0, [this, &mesh, classes, &classCors, &job](unsigned long from, unsigned long to) {
+				if (job->cancelled())
+					return;
+				calculateWeightClassCoRs_Interval(from, to, mesh, *classes, classCors);
+				job->advance(classes->offsets[to] - classes->offsets[from]);
+			});
+			if (job->cancelled())
+				return;
+
+			std::vector<glm::vec3> cors(vertexCount);
+			for (unsigned long v = 0; v < vertexCount; ++v)
+				cors[v] = classCors[classes->classOfVertex[v]];
+
+			finishStage("cors", globalClock);
+
+			if (callback)
+				callback(cors);
 		});
+		return job;
 	}
 
-	void CoRCalculator::saveCoRsToBinaryFile(const std::string & path, std::vector<glm::vec3>& cors) const
+	const WeightClasses & CoRCalculator::weightClassesOf(const CoRMesh & mesh, WeightClasses & localClasses) const
 	{
-		unsigned long corCount = cors.size();
+		if (mesh.weightClasses.classOfVertex.size() == mesh.vertices.size())
+			return mesh.weightClasses;
+		localClasses.build(mesh.weights);
+		return localClasses;
+	}
 
-		std::ofstream outputFile;
-		outputFile.open(path, std::ios::out | std::ios::binary);
-		outputFile << corCount;
-		outputFile.write(reinterpret_cast<char*>(cors.data()), 3 * sizeof(float) * cors.size());
-		outputFile.close();
+	void CoRCalculator::hashParameters(Fnv1a & fnv) const
+	{
+		fnv.update(_sigma);
+		fnv.update(_omega);
+		fnv.update(_similarityCutoff);
+	}
+
+	std::uint64_t CoRCalculator::bakeHash(const CoRMesh & mesh) const
+	{
+		Fnv1a fnv;
+		fnv.update(hashMesh(mesh));
+		hashParameters(fnv);
+		return fnv.value;
 	}
 
-	void CoRCalculator::saveCoRsToTextFile(const std::string &path, std::vector<glm::vec3> &cors, const std::string & separator) const {
+	bool CoRCalculator::bakeCoRsTiled(const CoRMesh & mesh, const std::string & checkpointPath, unsigned int tileSize, CoRJob * job) const
+	{
+		Clock clock;
+		clock.clockStart();
+		_stats.resetCounters();
+
+		const unsigned long vertexCount = mesh.vertices.size();
+		WeightClasses localClasses;
+		const WeightClasses &classes = weightClassesOf(mesh, localClasses);
+		_stats.setSizes(vertexCount, classes.size());
+
+		CoRCheckpoint checkpoint(checkpointPath, vertexCount, tileSize, bakeHash(mesh));
+		if (!checkpoint.good()) {
+			if (job)
+				job->finish();
+			return false;
+		}
+		if (job) {
+			job->setTotal(vertexCount);
+			job->resume(checkpoint.complete() ? vertexCount : checkpoint.tileBegin(checkpoint.completeTiles()));
+		}
+#ifdef COR_ENABLE_PROFILING
+		std::cout << "Tiled bake: resuming at tile " << checkpoint.completeTiles() << " of " << checkpoint.tileCount() << std::endl;
+#endif
+
+		// only the classes of the current tile are kept, so memory is bounded by the tile size;
+		// a class spanning several tiles is computed once per tile
+		std::unordered_map<unsigned int, unsigned int> slotOfClass;
+		std::vector<unsigned int> tileClasses;
+		std::vector<glm::vec3> classCors;
+		std::vector<glm::vec3> tileCors;
+
+		for (unsigned long tile = checkpoint.completeTiles(); tile < checkpoint.tileCount(); ++tile) {
+			if (job && job->cancelled()) {
+				job->finish();
+				return false;
+			}
+
+			const unsigned long first = checkpoint.tileBegin(tile);
+			const unsigned int count = checkpoint.tileVertexCount(tile);
+
+			slotOfClass.clear();
+			tileClasses.clear();
+			for (unsigned long v = first; v < first + count; ++v) {
+				unsigned int c = classes.classOfVertex[v];
+				if (slotOfClass.insert(std::make_pair(c, static_cast<unsigned int>(tileClasses.size()))).second)
+					tileClasses.push_back(c);
+			}
+
+			classCors.resize(tileClasses.size());
+			_pool->parallelFor(0, tileClasses.size(), 0, [&](unsigned long from, unsigned long to) {
+				CoRCounters counters;
+				for (unsigned long i = from; i < to; ++i)
+					calculateCoR(classes.representative(tileClasses[i]), mesh, classCors.data() + i, counters);
+				counters.cors += to - from;
+				_stats.add(counters);
+			});
+
+			tileCors.resize(count);
+			for (unsigned int i = 0; i < count; ++i)
+				tileCors[i] = classCors[slotOfClass[classes.classOfVertex[first + i]]];
+			if (!checkpoint.appendTile(tileCors.data())) {
+				if (job)
+					job->finish();
+				return false;
+			}
+
+			if (job)
+				job->advance(count);
+		}
+
+		finishStage("tiledBake", clock);
+		if (job)
+			job->finish();
+		return true;
+	}
+
+	bool CoRCalculator::bakeCoRShard(const CoRMesh & mesh, unsigned long from, unsigned long to, const std::string & shardPath, CoRJob * job) const
+	{
+		Clock clock;
+		clock.clockStart();
+		_stats.resetCounters();
+
+		const unsigned long vertexCount = mesh.vertices.size();
+		if (from > to || to > vertexCount) {
+			std::cerr << "Error: Shard [" << from << ", " << to << ") exceeds the " << vertexCount << " vertices of the mesh." << std::endl;
+			if (job)
+				job->finish();
+			return false;
+		}
+
+		WeightClasses localClasses;
+		const WeightClasses &classes = weightClassesOf(mesh, localClasses);
+
+		CoRShard shard;
+		shard.from = from;
+		shard.to = to;
+		shard.vertexCount = vertexCount;
+		shard.hash = bakeHash(mesh);
+		shard.cors.resize(to - from);
+		if (job)
+			job->setTotal(to - from);
+
+		// the distinct weight classes of the range, like calculateCoRs_Interval but computed once each
+		std::vector<unsigned int> rangeClasses;
+		std::vector<unsigned int> verticesInRange(classes.size(), 0);
+		for (unsigned long v = from; v < to; ++v) {
+			unsigned int c = classes.classOfVertex[v];
+			if (verticesInRange[c]++ == 0)
+				rangeClasses.push_back(c);
+		}
+
+		std::vector<glm::vec3> classCors(classes.size());
+		_pool->parallelFor(0, rangeClasses.size(), 0, [&](unsigned long first, unsigned long last) {
+			if (job && job->cancelled())
+				return;
+			CoRCounters counters;
+			unsigned long vertices = 0;
+			for (unsigned long i = first; i < last; ++i) {
+				calculateCoR(classes.representative(rangeClasses[i]), mesh, classCors.data() + rangeClasses[i], counters);
+				vertices += verticesInRange[rangeClasses[i]];
+			}
+			counters.cors += last - first;
+			_stats.add(counters);
+			if (job)
+				job->advance(vertices);
+		});
+
+		bool written = false;
+		if (!job || !job->cancelled()) {
+			for (unsigned long v = from; v < to; ++v)
+				shard.cors[v - from] = classCors[classes.classOfVertex[v]];
+			written = shard.write(shardPath);
+			if (!written)
+				std::cerr << "Error: Cannot write CoR shard " << shardPath << std::endl;
+		}
+
+		finishStage("shard", clock);
+		if (job)
+			job->finish();
+		return written;
+	}
+
+	bool CoRCalculator::saveCoRsToBinaryFile(const std::string & path, const std::vector<glm::vec3>& cors, std::uint64_t hash, CoREncoding encoding)
+	{
+		return writeCoRFile(path, cors.data(), cors.size(), hash, encoding);
+	}
+
+	void CoRCalculator::saveCoRsToTextFile(const std::string &path, std::vector<glm::vec3> &cors, const std::string & separator) {
 		unsigned long corCount = cors.size();
 
 		std::ofstream outputFile;
@@ -165,16 +458,15 @@ namespace CoR {
 		outputFile.close();
 	}
 
-	std::vector<glm::vec3> CoRCalculator::loadCoRsFromBinaryFile(const std::string & path) const
+	std::vector<glm::vec3> CoRCalculator::loadCoRsFromBinaryFile(const std::string & path, bool verifyChecksum)
 	{
-		unsigned int corCount = 0;
-
-		std::ifstream file(path, std::ifstream::in | std::ifstream::binary);
-		file >> corCount;
-		std::vector<glm::vec3> cors(corCount, glm::vec3(0.5));
-		file.read(reinterpret_cast<char*>(cors.data()), 3 * sizeof(float) * corCount);
-
-		return cors;
+		MappedCoRFile file;
+		std::string error;
+		if (!file.open(path, verifyChecksum, &error)) {
+			std::cerr << "Error: Cannot load cors from " << path << ": " << error << std::endl;
+			return std::vector<glm::vec3>();
+		}
+		return std::vector<glm::vec3>(file.cors().begin(), file.cors().end());
 	}
 
 	CoRMesh CoRCalculator::createCoRMesh(
@@ -183,118 +475,326 @@ namespace CoR {
 			std::vector<WeightsPerBone>& skeletonBoneWeights,
 			float subdivEpsilon) const
 	{
-		std::vector<glm::vec3> sub_vertices = vertices;
-		std::vector<unsigned int> sub_triangleIndices = indices;
-		std::vector<WeightsPerBone> sub_weights = skeletonBoneWeights;
+		return createCoRMesh(
+				std::vector<glm::vec3>(vertices),
+				std::vector<unsigned int>(indices),
+				std::vector<WeightsPerBone>(skeletonBoneWeights),
+				subdivEpsilon);
+	}
+
+	CoRMesh CoRCalculator::createCoRMesh(
+			std::vector<glm::vec3>&& vertices,
+			std::vector<unsigned int>&& indices,
+			std::vector<WeightsPerBone>&& skeletonBoneWeights,
+			float subdivEpsilon) const
+	{
+		Clock meshClock;
+		meshClock.clockStart();
+		std::vector<glm::vec3> sub_vertices = std::move(vertices);
+		std::vector<unsigned int> sub_triangleIndices = std::move(indices);
+		std::vector<WeightsPerBone> sub_weights = std::move(skeletonBoneWeights);
+
+		unsigned int maxIndex = sub_triangleIndices.empty() ? 0 : *std::max_element(sub_triangleIndices.begin(), sub_triangleIndices.end());
+		if (maxIndex >= sub_vertices.size() || maxIndex >= sub_weights.size()) {
+			std::cerr << "Error: Triangle indices refer to nonexistent vertex. Max index = "
+				<< maxIndex << ", but only " << sub_vertices.size() << " vertices exist." << std::endl;
+			exit(1);
+		}
 
 		// subdivision
 		if (_subdivide) {
-#ifdef COR_ENABLE_PROFILING
-			std::cout << "\tSubdividing mesh";
 			Clock subDivClock;
 			subDivClock.clockStart();
-#endif
-			for (int t = 0; t < sub_triangleIndices.size(); t += 3) {
-				for (int edgeBeg = 0; edgeBeg < 3; ++edgeBeg) {
-					int edgeEnd = (edgeBeg + 1) % 3;
-
-					int globalEdgeBeg = t + edgeBeg;
-					int globalEdgeEnd = t + edgeEnd;
-
-					unsigned int v0Index = sub_triangleIndices[globalEdgeBeg];
-					unsigned int v1Index = sub_triangleIndices[globalEdgeEnd];
-
-					WeightsPerBone &w0 = sub_weights[v0Index];
-					WeightsPerBone &w1 = sub_weights[v1Index];
-
-					if (skinningWeightsDistance(w0, w1) >= subdivEpsilon) {
-						// split edge into halfs
-
-						// 1.) calc new vertex
-						glm::vec3 v0 = sub_vertices[v0Index];
-						glm::vec3 v1 = sub_vertices[v1Index];
-						glm::vec3 newVertex = 0.5f * (v0 + v1);
-						unsigned int newVertexIndex = sub_vertices.size();
-						sub_vertices.push_back(newVertex);
-
-						// 2.) calc new weight by linear interpolating
-						sub_weights.push_back((w0 + w1) * 0.5f);
-
-						// 3.) split triangle into two new ones
-						unsigned int v2Index = sub_triangleIndices[t + ((edgeEnd + 1) % 3)];
-						// append first new triangle at end of triangle list
-						sub_triangleIndices.push_back(v0Index);
-						sub_triangleIndices.push_back(v2Index);
-						sub_triangleIndices.push_back(newVertexIndex);
-
-						// replace current triangle with second new one and ...
-						sub_triangleIndices[globalEdgeBeg] = newVertexIndex;
-						//    => sub_triangleIndices[globalEdgeEnd]   = globalEdgeEnd;
-						//    => sub_triangleIndices[lastVertexIndex] = lastVertexIndex;
-						// ...recheck it
-						t -= 3;
-						break;
-					}
-				}
-			}
-#ifdef COR_ENABLE_PROFILING
-			subDivClock.clockMessageAtCurrentTime("\tMesh subdivision took");
-#endif
+			MeshSubdivider subdivider(subdivEpsilon, _subdivisionLimits, _pool.get());
+			subdivider.subdivide(sub_vertices, sub_triangleIndices, sub_weights);
+			finishStage("subdivision", subDivClock);
 		}
 
+		const unsigned long triangleCount = sub_triangleIndices.size() / 3;
 		CoRMesh mesh(
-				sub_vertices,
-				std::vector<CoRTriangle>(sub_triangleIndices.size() / 3, CoRTriangle()),
-				sub_weights
+				std::move(sub_vertices),
+				std::vector<CoRTriangle>(triangleCount, CoRTriangle()),
+				std::move(sub_weights)
 		);
 
-		unsigned int maxIndex = *std::max_element(sub_triangleIndices.begin(), sub_triangleIndices.end());
-		if (maxIndex >= sub_vertices.size() || maxIndex >= sub_weights.size()) {
-			std::cerr << "Error: Triangle indices refer to nonexistent vertex. Max index = "
-				<< maxIndex << ", but only " << sub_vertices.size() << " vertices exist." << std::endl;
-			exit(1);
-		}
+		// weight classes only need the weights, so they are hashed while the triangles are converted
+		_pool->parallelFor(0, 2, 1, [&](unsigned long from, unsigned long) {
+			if (from == 0) {
+				Clock clock;
+				clock.clockStart();
+				mesh.weightClasses.build(mesh.weights);
+				finishStage("weightClasses", clock);
+			} else {
+				// convert triangle indices to triangles and precompute cor values
+				convertTriangles(sub_triangleIndices, &mesh);
+			}
+		});
 
-		// convert triangle indices to triangles and precompute cor values
-		convertTriangles(sub_triangleIndices, &mesh);
+		calculateMeshData(&mesh);
 
+		finishStage("preprocessing", meshClock);
 		return mesh;
 	}
 
-	void CoRCalculator::convertTriangles(std::vector<unsigned int> triangleIndices, CoRMesh *mesh) const
+	void CoRCalculator::convertTriangles(const std::vector<unsigned int> & triangleIndices, CoRMesh *mesh) const
 	{
-#ifdef COR_ENABLE_PROFILING
 		Clock clock;
 		clock.clockStart();
-#endif
 
-		std::vector<glm::vec3> &vertices = mesh->vertices;
 		std::vector<CoRTriangle> &triangles = mesh->triangles;
-		std::vector<WeightsPerBone> &weights = mesh->weights;
+		_pool->parallelFor(0, triangles.size(), 0, [&](unsigned long from, unsigned long to) {
+			for (unsigned long i = from; i < to; ++i) {
+				CoRTriangle &t = triangles[i];
+
+				unsigned long tIndex = 3 * i;
+				t.alpha = triangleIndices[tIndex];
+				t.beta = triangleIndices[tIndex + 1];
+				t.gamma = triangleIndices[tIndex + 2];
+			}
+		});
+
+		buildTriangleStore(mesh);
+
+		finishStage("triangleConversion", clock);
+	}
+
+	void CoRCalculator::buildTriangleStore(CoRMesh *mesh) const
+	{
+		const std::vector<glm::vec3> &vertices = mesh->vertices;
+		const std::vector<CoRTriangle> &triangles = mesh->triangles;
+		const std::vector<WeightsPerBone> &weights = mesh->weights;
+		CoRTriangleStore &store = mesh->triangleStore;
+
+		// first pass: centers, areas and the average weights, packed per chunk so every
+		// average is merged only once
+		const unsigned long triangleCount = triangles.size();
+		const unsigned long grainSize = std::max(1ul, triangleCount / (16ul * std::max(1u, _pool->size())));
+		const unsigned long chunkCount = (triangleCount + grainSize - 1) / grainSize;
+		std::vector<std::vector<unsigned short>> chunkBones(chunkCount);
+		std::vector<AlignedFloats> chunkValues(chunkCount);
+		store.resize(triangleCount);
+		_pool->parallelFor(0, triangleCount, grainSize, [&](unsigned long from, unsigned long to) {
+			std::vector<unsigned short> &bones = chunkBones[from / grainSize];
+			AlignedFloats &values = chunkValues[from / grainSize];
+			for (unsigned long i = from; i < to; ++i) {
+				const CoRTriangle &t = triangles[i];
+
+				glm::vec3 vAlpha = vertices[t.alpha];
+				glm::vec3 vBeta = vertices[t.beta];
+				glm::vec3 vGamma = vertices[t.gamma];
+
+				glm::vec3 center = (vAlpha + vBeta + vGamma) * (1.0f / 3.0f);
+				store.centerX[i] = center.x;
+				store.centerY[i] = center.y;
+				store.centerZ[i] = center.z;
+
+				glm::vec3 sideAB = vBeta - vAlpha;
+				glm::vec3 sideAC = vGamma - vAlpha;
+				store.area[i] = 0.5f * glm::length(glm::cross(sideAB, sideAC));// abs?
+
+				WeightsPerBone average = (weights[t.alpha] + weights[t.beta] + weights[t.gamma]) * (1.0f / 3.0f);
+				for (int j = 0; j < average.size(); ++j) {
+					bones.push_back(static_cast<unsigned short>(average.bone(j)));
+					values.push_back(average.weight(j));
+				}
+				store.weightOffsets[i + 1] = static_cast<unsigned int>(average.size());
+			}
+		});
+
+		// second pass: copy the chunks to their prefix-summed offsets
+		for (unsigned long i = 0; i < triangleCount; ++i)
+			store.weightOffsets[i + 1] += store.weightOffsets[i];
+		store.weightBones.resize(store.weightOffsets.back());
+		store.weightValues.resize(store.weightOffsets.back());
+		_pool->parallelFor(0, chunkCount, 1, [&](unsigned long from, unsigned long to) {
+			for (unsigned long c = from; c < to; ++c) {
+				unsigned int offset = store.weightOffsets[c * grainSize];
+				std::copy(chunkBones[c].begin(), chunkBones[c].end(), store.weightBones.begin() + offset);
+				std::copy(chunkValues[c].begin(), chunkValues[c].end(), store.weightValues.begin() + offset);
+			}
+		});
+
+		// the brute force integral only needs one entry per distinct average weight
+		if (_aggregateTriangles) {
+			store = store.aggregated();
+#ifdef COR_ENABLE_PROFILING
+			std::cout << "\tAggregated " << triangleCount << " triangles into " << store.size() << " weight classes" << std::endl;
+#endif
+		}
+
+		mesh->appendedEntries = 0;
+
+		// pruning index of the (possibly aggregated) entries for the brute force integral
+		if (_similarityCutoff > 0) {
+			Clock clock;
+			clock.clockStart();
+			mesh->bonePairs.build(store, _pool.get());
+			finishStage("bonePairIndex", clock);
+		}
+	}
+
+	std::vector<unsigned int> CoRCalculator::patchTriangleStore(
+			CoRMesh *mesh,
+			const std::vector<unsigned int> & modifiedTriangles,
+			const std::vector<WeightsPerBone> & oldAverages,
+			const std::vector<WeightsPerBone> & newAverages) const
+	{
+		CoRTriangleStore &store = mesh->triangleStore;
+		std::vector<unsigned int> changedEntries;
+
+		if (!_aggregateTriangles) {
+			// entries are the triangles
+			store.setWeights(modifiedTriangles, newAverages);
+			changedEntries = modifiedTriangles;
+		} else {
+			// the integral is linear in the area, so an entry of negative area cancels the old contribution
+			for (unsigned long i = 0; i < modifiedTriangles.size(); ++i) {
+				const CoRTriangle &t = mesh->triangles[modifiedTriangles[i]];
+				glm::vec3 vAlpha = mesh->vertices[t.alpha];
+				glm::vec3 vBeta = mesh->vertices[t.beta];
+				glm::vec3 vGamma = mesh->vertices[t.gamma];
+				glm::vec3 center = (vAlpha + vBeta + vGamma) * (1.0f / 3.0f);
+				float area = 0.5f * glm::length(glm::cross(vBeta - vAlpha, vGamma - vAlpha));
+
+				if (oldAverages[i].size() >= 2) {
+					changedEntries.push_back(static_cast<unsigned int>(store.size()));
+					store.push_back(center, -area, oldAverages[i]);
+				}
+				if (newAverages[i].size() >= 2) {
+					changedEntries.push_back(static_cast<unsigned int>(store.size()));
+					store.push_back(center, area, newAverages[i]);
+				}
+			}
+			mesh->appendedEntries += changedEntries.size();
 
-		for (int i = 0; i < triangles.size(); ++i) {
-			CoRTriangle &t = triangles[i];
+			// merge the corrections once they make up an eighth of the store
+			if (8 * mesh->appendedEntries > store.size()) {
+				buildTriangleStore(mesh);
+				changedEntries.clear();
+				return changedEntries;
+			}
+		}
+
+		if (_similarityCutoff > 0) {
+			if (8 * (mesh->bonePairs.unindexed.size() + changedEntries.size()) > store.size())
+				mesh->bonePairs.build(store, _pool.get());
+			else
+				mesh->bonePairs.addUnindexed(changedEntries);
+		}
+		return changedEntries;
+	}
 
-			int tIndex = 3 * i;
-			t.alpha = triangleIndices[tIndex];
-			t.beta = triangleIndices[tIndex + 1];
-			t.gamma = triangleIndices[tIndex + 2];
+	std::vector<unsigned int> CoRCalculator::updateCoRs(
+			CoRMesh & mesh,
+			const std::vector<unsigned int> & changedVertices,
+			const std::vector<WeightsPerBone> & newWeights,
+			std::vector<glm::vec3> & cors) const
+	{
+		Clock clock;
+		clock.clockStart();
+		_stats.resetCounters();
 
-			glm::vec3 vAlpha = vertices[t.alpha];
-			glm::vec3 vBeta = vertices[t.beta];
-			glm::vec3 vGamma = vertices[t.gamma];
+		const unsigned long vertexCount = mesh.vertices.size();
+		if (cors.size() != vertexCount || changedVertices.size() != newWeights.size()) {
+			std::cerr << "Error: Incremental CoR update needs " << vertexCount << " cors and one weight per changed vertex, got "
+				<< cors.size() << " cors and " << newWeights.size() << " weights for " << changedVertices.size() << " vertices." << std::endl;
+			return std::vector<unsigned int>();
+		}
 
-			t.center = (vAlpha + vBeta + vGamma) * (1.0f / 3.0f);
-			t.averageWeight = (weights[t.alpha] + weights[t.beta] + weights[t.gamma]) * (1.0f / 3.0f);
+		// kept in the mesh for the next update
+		if (mesh.trianglesOfVertex.size() != vertexCount)
+			mesh.trianglesOfVertex.buildVertexTriangles(mesh.triangles, vertexCount);
+
+		// triangles around the changed vertices, each once
+		std::vector<unsigned int> modifiedTriangles;
+		for (unsigned int v : changedVertices)
+			for (unsigned int t : mesh.trianglesOfVertex[v])
+				modifiedTriangles.push_back(t);
+		std::sort(modifiedTriangles.begin(), modifiedTriangles.end());
+		modifiedTriangles.erase(std::unique(modifiedTriangles.begin(), modifiedTriangles.end()), modifiedTriangles.end());
+
+		auto averageWeight = [&mesh](unsigned int triangle) {
+			const CoRTriangle &t = mesh.triangles[triangle];
+			return (mesh.weights[t.alpha] + mesh.weights[t.beta] + mesh.weights[t.gamma]) * (1.0f / 3.0f);
+		};
+		std::vector<WeightsPerBone> oldAverages(modifiedTriangles.size());
+		for (unsigned long i = 0; i < modifiedTriangles.size(); ++i)
+			oldAverages[i] = averageWeight(modifiedTriangles[i]);
+		for (unsigned long i = 0; i < changedVertices.size(); ++i) {
+			mesh.weights[changedVertices[i]] = newWeights[i];
+			// an upper bound is enough to pick the kernel
+			mesh.maxInfluences = std::max(mesh.maxInfluences, newWeights[i].size());
+		}
+		std::vector<WeightsPerBone> newAverages(modifiedTriangles.size());
+		for (unsigned long i = 0; i < modifiedTriangles.size(); ++i)
+			newAverages[i] = averageWeight(modifiedTriangles[i]);
+
+		// a similarity needs two shared bones, so only vertices with a bone pair of an old or new
+		// average weight of a modified triangle can see a different integral
+		std::unordered_set<std::uint32_t> modifiedBonePairs;
+		auto addBonePairs = [&](const WeightsPerBone &average) {
+			for (int j = 0; j < average.size(); ++j)
+				for (int k = j + 1; k < average.size(); ++k)
+					modifiedBonePairs.insert((average.bone(j) << 16) | average.bone(k));
+		};
+		for (unsigned long i = 0; i < modifiedTriangles.size(); ++i) {
+			addBonePairs(oldAverages[i]);
+			addBonePairs(newAverages[i]);
+		}
 
-			glm::vec3 sideAB = vBeta - vAlpha;
-			glm::vec3 sideAC = vGamma - vAlpha;
-			t.area = 0.5f * glm::length(glm::cross(sideAB, sideAC));// abs?
+		std::vector<unsigned int> changedClasses;
+		bool renumbered = mesh.weightClasses.update(mesh.weights, changedVertices, changedClasses);
+		std::vector<unsigned int> changedEntries = patchTriangleStore(&mesh, modifiedTriangles, oldAverages, newAverages);
+		if (renumbered) {
+			calculateClassData(&mesh);
+			updateWeightData(&mesh, std::vector<unsigned int>(), changedEntries);
+		} else {
+			updateWeightData(&mesh, changedClasses, changedEntries);
 		}
 
+		const WeightClasses &classes = mesh.weightClasses;
+		std::vector<bool> isAffected(classes.size(), false);
+		for (unsigned long c = 0; c < classes.size(); ++c) {
+			if (classes.count(c) == 0)
+				continue;
+			const WeightsPerBone &w = mesh.weights[classes.representative(c)];
+			for (int j = 0; j < w.size() && !isAffected[c]; ++j)
+				for (int k = j + 1; k < w.size() && !isAffected[c]; ++k)
+					isAffected[c] = modifiedBonePairs.count((w.bone(j) << 16) | w.bone(k)) > 0;
+		}
+		for (unsigned int c : changedClasses)
+			isAffected[c] = true;
+
+		std::vector<unsigned int> affectedClasses;
+		for (unsigned long c = 0; c < classes.size(); ++c)
+			if (isAffected[c])
+				affectedClasses.push_back(static_cast<unsigned int>(c));
+
+		std::vector<glm::vec3> classCors(affectedClasses.size());
+		_pool->parallelFor(0, affectedClasses.size(), 0, [&](unsigned long from, unsigned long to) {
+			CoRCounters counters;
+			for (unsigned long i = from; i < to; ++i)
+				calculateCoR(classes.representative(affectedClasses[i]), mesh, classCors.data() + i, counters);
+			counters.cors += to - from;
+			_stats.add(counters);
+		});
+
+		std::vector<unsigned int> updatedVertices;
+		for (unsigned long i = 0; i < affectedClasses.size(); ++i) {
+			unsigned int c = affectedClasses[i];
+			for (unsigned int m = classes.offsets[c]; m < classes.offsets[c + 1]; ++m) {
+				cors[classes.vertices[m]] = classCors[i];
+				updatedVertices.push_back(classes.vertices[m]);
+			}
+		}
+		std::sort(updatedVertices.begin(), updatedVertices.end());
+
 #ifdef COR_ENABLE_PROFILING
-		clock.clockMessageAtCurrentTime("Triangle conversion took");
+		std::cout << "Incremental update: " << changedVertices.size() << " changed vertices, " << modifiedTriangles.size() << " modified triangles, "
+				  << updatedVertices.size() << " recomputed cors" << std::endl;
 #endif
+		finishStage("incrementalUpdate", clock);
+		return updatedVertices;
 	}
 
 	BFSCoRCalculator::BFSCoRCalculator(
@@ -302,72 +802,123 @@ namespace CoR {
 			float omega,
 			bool subdivide,
 			unsigned int numberOfThreadsToCreate,
-			float bfsEpsilon) : CoRCalculator(sigma, omega, subdivide, numberOfThreadsToCreate), _bfsEpsilon(bfsEpsilon)
+			float bfsEpsilon,
+			float annApproximation) : CoRCalculator(sigma, omega, subdivide, numberOfThreadsToCreate), _bfsEpsilon(bfsEpsilon), _annApproximation(annApproximation)
 	{
 
 	}
 
-	void BFSCoRCalculator::convertTriangles(std::vector<unsigned int> triangleIndices, CoRMesh * mesh) const
+	BFSCoRCalculator::BFSCoRCalculator(
+			const std::shared_ptr<ThreadPool> & pool,
+			float sigma,
+			float omega,
+			bool subdivide,
+			float bfsEpsilon,
+			float annApproximation) : CoRCalculator(pool, sigma, omega, subdivide), _bfsEpsilon(bfsEpsilon), _annApproximation(annApproximation)
 	{
-		CoRCalculator::convertTriangles(triangleIndices, mesh);
-		std::vector<CoRTriangle> &triangles = mesh->triangles;
 
-		unsigned long vertexCount = mesh->vertices.size();
-		mesh->trianglesOfVertex = std::vector<std::vector<CoRTriangle*>>(vertexCount, std::vector<CoRTriangle*>());
-		mesh->verticesWithSimilarSkinningWeights = std::vector<std::vector<int>>(vertexCount, std::vector<int>());
-
-		for (auto &t : triangles) {
-			// add t to triangles of vertices alpha, beta, gamma
-			mesh->trianglesOfVertex[t.alpha].push_back(&t);
-			mesh->trianglesOfVertex[t.beta].push_back(&t);
-			mesh->trianglesOfVertex[t.gamma].push_back(&t);
-		}
+	}
 
+	void BFSCoRCalculator::calculateMeshData(CoRMesh * mesh) const
+	{
 		calculateANNData(mesh, _omega);
 	}
 
-	bool BFSCoRCalculator::calculateCoR(unsigned long vertex, const CoRMesh & mesh, glm::vec3 * corOut) const
+	void BFSCoRCalculator::hashParameters(Fnv1a & fnv) const
 	{
-		WeightsPerBone weight = mesh.weights[vertex];
+		CoRCalculator::hashParameters(fnv);
+		fnv.update(_bfsEpsilon);
+		fnv.update(_annApproximation);
+	}
 
-		// find triangles for bfs
-		std::vector<CoRTriangle*> trianglesToVisit;
-		for (int homie : mesh.verticesWithSimilarSkinningWeights[vertex]) {
-			trianglesToVisit.insert(
-					trianglesToVisit.end(),
-					mesh.trianglesOfVertex.at(homie).begin(),
-					mesh.trianglesOfVertex.at(homie).end());
+	void BFSCoRCalculator::updateWeightData(CoRMesh * mesh, const std::vector<unsigned int> & changedClasses, const std::vector<unsigned int> & /*changedEntries*/) const
+	{
+		if (changedClasses.empty())
+			return;
+		std::vector<WeightsPerBone> weights(changedClasses.size());
+		for (unsigned long i = 0; i < changedClasses.size(); ++i)
+			weights[i] = mesh->weightClasses.weightOfClass[changedClasses[i]];
+		mesh->similarWeightClasses.update(changedClasses, weights, &threadPool());
+	}
+
+	void BFSCoRCalculator::calculateClassData(CoRMesh * mesh) const
+	{
+		Clock clock;
+		clock.clockStart();
+		mesh->similarWeightClasses.build(mesh->weightClasses.weightOfClass, _omega, _annApproximation, &threadPool());
+		finishStage("weightNeighbourhoods", clock);
+	}
+
+	bool BFSCoRCalculator::calculateCoR(unsigned long vertex, const CoRMesh & mesh, glm::vec3 * corOut, CoRCounters & counters) const
+	{
+		*corOut = glm::vec3(0);
+		// similarity needs at least two shared bones
+		if (mesh.weights[vertex].size() < 2)
+			return false;
+
+		SimilarityKernel kernel(_sigma, mesh.maxInfluences);
+		kernel.setVertex(mesh.weights[vertex]);
+
+		BFSScratch &scratch = bfsScratch;
+		scratch.begin(mesh.triangles.size());
+
+		// seed with the triangles of all vertices with similar skinning weights
+		const WeightClasses &classes = mesh.weightClasses;
+		const WeightNeighbourIndex &similar = mesh.similarWeightClasses;
+		unsigned int weightClass = classes.classOfVertex[vertex];
+		for (unsigned int n = similar.offsets[weightClass]; n < similar.offsets[weightClass + 1]; ++n) {
+			unsigned int similarClass = similar.neighbours[n];
+			for (unsigned int m = classes.offsets[similarClass]; m < classes.offsets[similarClass + 1]; ++m) {
+				unsigned int homie = classes.vertices[m];
+				for (unsigned int t : mesh.trianglesOfVertex[homie])
+					scratch.push(t);
+			}
 		}
 
-		std::map<CoRTriangle*, bool> visited;
 		glm::vec3 numerator(0);
 		float denominator = 0;
 
-		for (int i = 0; i < trianglesToVisit.size(); ++i) {
-			CoRTriangle* t = trianglesToVisit[i];
-
-			if (visited[t])
-				continue;
-			visited[t] = true;
-
-			float sim = similarity(weight, t->averageWeight, _sigma);
-			if (sim >= _bfsEpsilon) {
-				float areaTimesSim = t->area*sim;
-				numerator += areaTimesSim * t->center;
-				denominator += areaTimesSim;
-
-				for (CoRTriangle *neighbour : t->_neighbours) {
-					if (!visited[neighbour])
-						trianglesToVisit.push_back(neighbour);
+		const CoRTriangleStore &store = mesh.triangleStore;
+		float sims[SimilarityKernel::BatchSize];
+
+		// every queued triangle is unique, so the queue is scored front to back in batches;
+		// batches end at level boundaries to count the bfs depth
+		unsigned long depth = 0;
+		size_t levelEnd = 0;
+		for (size_t i = 0; i < scratch.queue.size();) {
+			if (i == levelEnd) {
+				++depth;
+				levelEnd = scratch.queue.size();
+			}
+			unsigned int lanes = static_cast<unsigned int>(std::min<size_t>(SimilarityKernel::BatchSize, levelEnd - i));
+			kernel.evaluateIndexed(store, scratch.queue.data() + i, lanes, sims);
+			counters.similarityEvaluations += lanes;
+
+			for (unsigned int l = 0; l < lanes; ++l) {
+				float sim = sims[l];
+				if (sim < _bfsEpsilon) {
+					++counters.trianglesPruned;
+				} else {
+					// the queue may grow below, so read the id before
+					unsigned int t = scratch.queue[i + l];
+					float areaTimesSim = store.area[t] * sim;
+					numerator += areaTimesSim * store.center(t);
+					denominator += areaTimesSim;
+
+					for (unsigned int neighbour : mesh.triangleNeighbours[t])
+						scratch.push(neighbour);
 				}
 			}
+			i += lanes;
 		}
 
+		counters.trianglesVisited += scratch.queue.size();
+		counters.bfsDepthSum += depth;
+		counters.maxBfsDepth = std::max(counters.maxBfsDepth, depth);
+
 		//p_i^*
-		glm::vec3 cor(0);
 		if (denominator != 0)
-			cor = numerator / denominator;
-		*corOut = cor;
+			*corOut = numerator / denominator;
 
 		return denominator != 0; // <=> has cor
 	}
@@ -375,48 +926,187 @@ namespace CoR {
 	void BFSCoRCalculator::calculateANNData(CoRMesh * mesh, float omega) const
 	{
 		unsigned long vertexCount = mesh->vertices.size();
-#ifdef COR_ENABLE_PROFILING
-		std::cout << "\tCache vertices with similar skinning weights and triangle neighbourhood" << std::endl;
 		Clock clock;
 		clock.clockStart();
-		std::cout << "calcuateANNData:: vertexCount: " << vertexCount << std::endl;
-#endif
 
-		for (int i = 0; i < vertexCount; ++i) {
-#ifdef COR_ENABLE_PROFILING
-			if (i % 1000 == 0) {
-				std::cout << i << " vertices completed ";
-				clock.clockMessageAtCurrentTime("in");
-				std:: cout << vertexCount - i << " vertices left." << std::endl;
-				
+		// skinning weight neighbourhoods between classes of identical weights
+		const std::vector<WeightsPerBone> &weightOfClass = mesh->weightClasses.weightOfClass;
+
+		// the triangle adjacency does not depend on the weights, so both are built side by side
+		EdgeStatistics edges;
+		threadPool().parallelFor(0, 2, 1, [&](unsigned long from, unsigned long) {
+			Clock stageClock;
+			stageClock.clockStart();
+			if (from == 0) {
+				mesh->similarWeightClasses.build(weightOfClass, omega, _annApproximation, &threadPool());
+				finishStage("weightNeighbourhoods", stageClock);
+			} else {
+				mesh->trianglesOfVertex.buildVertexTriangles(mesh->triangles, vertexCount);
+				edges = mesh->triangleNeighbours.buildTriangleNeighbours(mesh->triangles, vertexCount);
+				finishStage("triangleAdjacency", stageClock);
 			}
+		});
+
+		recordEdges(edges);
+
+#ifdef COR_ENABLE_PROFILING
+		std::cout << "\t" << weightOfClass.size() << " weight classes with " << mesh->similarWeightClasses.neighbours.size() << " similar class pairs" << std::endl;
+		std::cout << "\t" << edges.edges << " edges, " << edges.boundaryEdges << " boundary, " << edges.nonManifoldEdges << " non-manifold" << std::endl;
 #endif
-			WeightsPerBone &wi = mesh->weights[i];
-			for (int j = i + 1; j < vertexCount; ++j) {
-				WeightsPerBone &wj = mesh->weights[j];
-				if (skinningWeightsDistance(wi, wj) < omega) {
-					mesh->verticesWithSimilarSkinningWeights[i].push_back(j);
-					mesh->verticesWithSimilarSkinningWeights[j].push_back(i);
-				}
+
+		finishStage("bfsData", clock);
+	}
+
+	HierarchicalCoRCalculator::HierarchicalCoRCalculator(
+			float sigma,
+			float omega,
+			bool subdivide,
+			unsigned int numberOfThreadsToCreate,
+			float tolerance,
+			unsigned int leafSize) : CoRCalculator(sigma, omega, subdivide, numberOfThreadsToCreate), _tolerance(tolerance), _leafSize(leafSize)
+	{
+
+	}
+
+	HierarchicalCoRCalculator::HierarchicalCoRCalculator(
+			const std::shared_ptr<ThreadPool> & pool,
+			float sigma,
+			float omega,
+			bool subdivide,
+			float tolerance,
+			unsigned int leafSize) : CoRCalculator(pool, sigma, omega, subdivide), _tolerance(tolerance), _leafSize(leafSize)
+	{
+
+	}
+
+	void HierarchicalCoRCalculator::calculateMeshData(CoRMesh * mesh) const
+	{
+		Clock clock;
+		clock.clockStart();
+		mesh->weightTree.build(mesh->triangleStore, _leafSize);
+		finishStage("weightTree", clock);
+	}
+
+	void HierarchicalCoRCalculator::updateWeightData(CoRMesh * mesh, const std::vector<unsigned int> & /*changedClasses*/, const std::vector<unsigned int> & changedEntries) const
+	{
+		// the entries are the triangles, so the tree only needs new bounds above the changed ones
+		if (mesh->weightTree.positions.size() == mesh->triangleStore.size())
+			mesh->weightTree.refit(mesh->triangleStore, changedEntries);
+		else
+			mesh->weightTree.build(mesh->triangleStore, _leafSize);
+	}
+
+	void HierarchicalCoRCalculator::hashParameters(Fnv1a & fnv) const
+	{
+		CoRCalculator::hashParameters(fnv);
+		fnv.update(_tolerance);
+		fnv.update(_leafSize);
+	}
+
+	namespace {
+		// a tree node awaiting refinement with its similarity bounds
+		struct FrontierNode {
+			float gap;
+			unsigned int node;
+			float lower, upper;
+
+			bool operator < (const FrontierNode & other) const {
+				return gap < other.gap;
 			}
+		};
+
+		thread_local std::vector<FrontierNode> frontier;
+	}
+
+	bool HierarchicalCoRCalculator::calculateCoR(unsigned long vertex, const CoRMesh & mesh, glm::vec3 * corOut, CoRCounters & counters) const
+	{
+		const WeightSpaceTree &tree = mesh.weightTree;
+		const CoRTriangleStore &store = mesh.triangleStore;
+		const WeightsPerBone &weight = mesh.weights[vertex];
 
-			// find triangle neighbourhood
-			std::vector<CoRTriangle*> &incidentTriangles = mesh->trianglesOfVertex[i];
-			for (int t0 = 0; t0 < incidentTriangles.size(); ++t0) {
-				for (int t1 = t0 + 1; t1 < incidentTriangles.size(); ++t1) {
-					CoRTriangle *triangle0 = incidentTriangles[t0];
-					CoRTriangle *triangle1 = incidentTriangles[t1];
+		SimilarityKernel kernel(_sigma, mesh.maxInfluences);
+		kernel.setVertex(weight);
+		float sims[SimilarityKernel::BatchSize];
 
-					if (triangle0->tryAddNeighbour(*triangle1)) {
-						triangle1->_neighbours.push_back(triangle0);
-					}
+		// exact sums of the refined leaves
+		glm::vec3 numerator(0);
+		float denominator = 0;
+		// bounds of the similarity weighted area, exact leaves included
+		double lowerArea = 0, upperArea = 0;
+		unsigned long evaluated = 0;
+
+		frontier.clear();
+		auto openNode = [&](unsigned int n) {
+			const WeightSpaceTree::Node &node = tree.nodes[n];
+			float lower, upper;
+			tree.similarityBounds(node, weight, _sigma, lower, upper);
+			// nodes sharing no bone pair with the vertex contribute nothing
+			if (upper <= 0)
+				return;
+			lowerArea += lower * node.area;
+			upperArea += upper * node.area;
+			frontier.push_back(FrontierNode{(upper - lower) * node.area, n, lower, upper});
+			std::push_heap(frontier.begin(), frontier.end());
+		};
+		if (!tree.empty())
+			openNode(0);
+
+		while (!frontier.empty() && upperArea - lowerArea > _tolerance * lowerArea) {
+			std::pop_heap(frontier.begin(), frontier.end());
+			FrontierNode loosest = frontier.back();
+			frontier.pop_back();
+
+			const WeightSpaceTree::Node &node = tree.nodes[loosest.node];
+			lowerArea -= loosest.lower * node.area;
+			upperArea -= loosest.upper * node.area;
+
+			if (!node.leaf()) {
+				openNode(node.children);
+				openNode(node.children + 1);
+				continue;
+			}
+
+			float leafArea = 0;
+			for (unsigned int first = 0; first < node.count; first += SimilarityKernel::BatchSize) {
+				unsigned int lanes = std::min<unsigned int>(SimilarityKernel::BatchSize, node.count - first);
+				const unsigned int *entries = tree.entries.data() + node.first + first;
+				kernel.evaluateIndexed(store, entries, lanes, sims);
+
+				for (unsigned int l = 0; l < lanes; ++l) {
+					float areaTimesSim = store.area[entries[l]] * sims[l];
+					numerator.x += areaTimesSim * store.centerX[entries[l]];
+					numerator.y += areaTimesSim * store.centerY[entries[l]];
+					numerator.z += areaTimesSim * store.centerZ[entries[l]];
+					leafArea += areaTimesSim;
 				}
 			}
+			denominator += leafArea;
+			lowerArea += leafArea;
+			upperArea += leafArea;
+			evaluated += node.count;
 		}
 
-#ifdef COR_ENABLE_PROFILING
-		clock.clockMessageAtCurrentTime("Calculation of BFS data took");
-#endif
+		// the unrefined nodes count with the mean of their bounds
+		for (const FrontierNode &pending : frontier) {
+			const WeightSpaceTree::Node &node = tree.nodes[pending.node];
+			float sim = 0.5f * (pending.lower + pending.upper);
+			numerator.x += sim * node.momentX;
+			numerator.y += sim * node.momentY;
+			numerator.z += sim * node.momentZ;
+			denominator += sim * node.area;
+		}
+
+		counters.similarityEvaluations += evaluated;
+		counters.trianglesVisited += evaluated;
+		counters.trianglesPruned += store.size() - evaluated;
+
+		//p_i^*
+		glm::vec3 cor(0);
+		if (denominator != 0)
+			cor = numerator / denominator;
+		*corOut = cor;
+
+		return denominator != 0;
 	}
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,158 @@
+#include <cor/CoRCheckpoint.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace CoR {
+    namespace {
+        const char Magic[8] = {'C', 'O', 'R', 'C', 'K', 'P', 'T', '1'};
+        const std::uint32_t Version = 1;
+
+        struct Header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t tileSize;
+            std::uint64_t vertexCount;
+            std::uint64_t hash;
+        };
+
+        struct TileHeader {
+            std::uint64_t tile;
+            std::uint32_t count;
+            std::uint32_t checksum;
+        };
+
+        std::uint32_t checksum(const glm::vec3 *cors, unsigned int count)
+        {
+            Fnv1a fnv;
+            fnv.update(cors, 3 * sizeof(float) * count);
+            return static_cast<std::uint32_t>(fnv.value ^ (fnv.value >> 32));
+        }
+
+        bool readHeader(std::istream &file, Header &header)
+        {
+            file.read(reinterpret_cast<char *>(&header), sizeof(header));
+            return file && std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 && header.version == Version && header.tileSize > 0;
+        }
+
+        // reads tiles until the first missing or damaged one and returns how many were complete
+        unsigned long readTiles(std::istream &file, const Header &header, std::vector<glm::vec3> *cors)
+        {
+            unsigned long tileCount = (header.vertexCount + header.tileSize - 1) / header.tileSize;
+            std::vector<glm::vec3> tile(header.tileSize);
+            unsigned long complete = 0;
+            for (; complete < tileCount; ++complete) {
+                unsigned long expected = std::min<unsigned long>(header.tileSize, header.vertexCount - complete * header.tileSize);
+                TileHeader tileHeader;
+                file.read(reinterpret_cast<char *>(&tileHeader), sizeof(tileHeader));
+                if (!file || tileHeader.tile != complete || tileHeader.count != expected)
+                    break;
+                file.read(reinterpret_cast<char *>(tile.data()), 3 * sizeof(float) * expected);
+                if (!file || checksum(tile.data(), tileHeader.count) != tileHeader.checksum)
+                    break;
+                if (cors)
+                    cors->insert(cors->end(), tile.begin(), tile.begin() + expected);
+            }
+            return complete;
+        }
+    }
+
+    std::uint64_t hashMesh(const CoRMesh &mesh)
+    {
+        Fnv1a fnv;
+        fnv.update(static_cast<std::uint64_t>(mesh.vertices.size()));
+        for (const glm::vec3 &v : mesh.vertices) {
+            fnv.update(v.x);
+            fnv.update(v.y);
+            fnv.update(v.z);
+        }
+        fnv.update(static_cast<std::uint64_t>(mesh.triangles.size()));
+        for (const CoRTriangle &t : mesh.triangles) {
+            fnv.update(t.alpha);
+            fnv.update(t.beta);
+            fnv.update(t.gamma);
+        }
+        for (const WeightsPerBone &w : mesh.weights)
+            fnv.update(static_cast<std::uint64_t>(w.hash()));
+        return fnv.value;
+    }
+
+    CoRCheckpoint::CoRCheckpoint(const std::string &path, unsigned long vertexCount, unsigned int tileSize, std::uint64_t hash)
+            : _vertexCount(vertexCount), _tileSize(tileSize > 0 ? tileSize : 1), _hash(hash), _completeTiles(0)
+    {
+        std::streamoff resumeAt = 0;
+        {
+            std::ifstream existing(path, std::ios::in | std::ios::binary);
+            Header header;
+            if (existing && readHeader(existing, header) && header.vertexCount == _vertexCount && header.tileSize == _tileSize && header.hash == _hash) {
+                _completeTiles = readTiles(existing, header, nullptr);
+                resumeAt = static_cast<std::streamoff>(sizeof(Header));
+                for (unsigned long tile = 0; tile < _completeTiles; ++tile)
+                    resumeAt += sizeof(TileHeader) + 3 * sizeof(float) * tileVertexCount(tile);
+            }
+        }
+
+        if (resumeAt > 0) {
+            // the damaged tail, if any, is overwritten by the next tile
+            _file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+            _file.seekp(resumeAt);
+        } else {
+            _file.open(path, std::ios::out | std::ios::trunc | std::ios::binary);
+            Header header;
+            std::memcpy(header.magic, Magic, sizeof(Magic));
+            header.version = Version;
+            header.tileSize = _tileSize;
+            header.vertexCount = _vertexCount;
+            header.hash = _hash;
+            _file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            _file.flush();
+        }
+
+        if (!_file)
+            std::cerr << "Error: Cannot open CoR checkpoint " << path << std::endl;
+    }
+
+    unsigned int CoRCheckpoint::tileVertexCount(unsigned long tile) const
+    {
+        return static_cast<unsigned int>(std::min<unsigned long>(_tileSize, _vertexCount - tile * _tileSize));
+    }
+
+    bool CoRCheckpoint::appendTile(const glm::vec3 *cors)
+    {
+        if (!_file)
+            return false;
+
+        TileHeader tileHeader;
+        tileHeader.tile = _completeTiles;
+        tileHeader.count = tileVertexCount(_completeTiles);
+        tileHeader.checksum = checksum(cors, tileHeader.count);
+
+        _file.write(reinterpret_cast<const char *>(&tileHeader), sizeof(tileHeader));
+        _file.write(reinterpret_cast<const char *>(cors), 3 * sizeof(float) * tileHeader.count);
+        _file.flush();
+        if (!_file) {
+            std::cerr << "Error: Writing CoR checkpoint tile " << _completeTiles << " failed" << std::endl;
+            return false;
+        }
+        ++_completeTiles;
+        return true;
+    }
+
+    bool CoRCheckpoint::load(const std::string &path, std::vector<glm::vec3> &cors, std::uint64_t expectedHash)
+    {
+        cors.clear();
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        Header header;
+        if (!file || !readHeader(file, header) || (expectedHash != 0 && header.hash != expectedHash))
+            return false;
+
+        cors.reserve(header.vertexCount);
+        unsigned long tileCount = (header.vertexCount + header.tileSize - 1) / header.tileSize;
+        if (readTiles(file, header, &cors) != tileCount) {
+            cors.clear();
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,316 @@
+#include <cor/CoRFile.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cor/CoRCheckpoint.h>
+#include <cor/CoRQuantization.h>
+
+namespace CoR {
+    namespace {
+        const char Magic[8] = {'C', 'O', 'R', 'S', 'F', 'I', 'L', 'E'};
+        const std::uint32_t PayloadAlignment = 16;
+        // the legacy format and the in place view rely on tightly packed floats
+        static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 is three packed floats");
+
+        std::uint32_t swapBytes(std::uint32_t value)
+        {
+            return (value >> 24) | ((value >> 8) & 0xff00u) | ((value << 8) & 0xff0000u) | (value << 24);
+        }
+
+        std::uint64_t swapBytes(std::uint64_t value)
+        {
+            return (static_cast<std::uint64_t>(swapBytes(static_cast<std::uint32_t>(value))) << 32)
+                   | swapBytes(static_cast<std::uint32_t>(value >> 32));
+        }
+
+        std::uint64_t checksum(const void *payload, std::size_t size)
+        {
+            Fnv1a fnv;
+            fnv.update(payload, size);
+            return fnv.value;
+        }
+
+        bool writePayload(const std::string &path, const void *payload, std::size_t payloadSize, std::size_t count,
+                          std::uint32_t stride, std::uint64_t hash, CoREncoding encoding)
+        {
+            CoRFileHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, Magic, sizeof(Magic));
+            header.version = CoRFileHeader::Version;
+            header.endianness = CoRFileHeader::EndiannessMarker;
+            header.count = count;
+            header.stride = stride;
+            header.payloadOffset = sizeof(header);
+            header.hash = hash;
+            header.checksum = checksum(payload, payloadSize);
+            header.encoding = static_cast<std::uint32_t>(encoding);
+            header.payloadSize = payloadSize;
+
+            std::string partialPath = path + ".partial";
+            {
+                std::ofstream file(partialPath, std::ios::out | std::ios::trunc | std::ios::binary);
+                file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                file.write(static_cast<const char *>(payload), payloadSize);
+                if (!file)
+                    return false;
+            }
+#ifdef _WIN32
+            // rename does not replace an existing file on Windows
+            std::remove(path.c_str());
+#endif
+            return std::rename(partialPath.c_str(), path.c_str()) == 0;
+        }
+    }
+
+    bool writeCoRFile(const std::string &path, const glm::vec3 *cors, std::size_t count, std::uint64_t hash, CoREncoding encoding)
+    {
+        if (encoding == CoREncoding::Quantized16)
+            return writeCoRFile(path, QuantizedCoRs::quantize(cors, count), hash);
+        return writePayload(path, cors, sizeof(glm::vec3) * count, count, sizeof(glm::vec3), hash, encoding);
+    }
+
+    bool writeCoRFile(const std::string &path, const QuantizedCoRs &quantized, std::uint64_t hash)
+    {
+        std::vector<std::uint8_t> encoded;
+        encodeQuantizedCoRs(quantized, encoded);
+        return writePayload(path, encoded.data(), encoded.size(), quantized.size(), 3 * sizeof(std::uint16_t), hash,
+                            CoREncoding::Quantized16);
+    }
+
+    MappedCoRFile::~MappedCoRFile()
+    {
+        close();
+    }
+
+    bool MappedCoRFile::open(const std::string &path, bool verifyChecksum, std::string *error)
+    {
+        close();
+        if (!map(path, error))
+            return false;
+        if (_mappingSize < sizeof(Magic) || std::memcmp(_mapping, Magic, sizeof(Magic)) != 0)
+            return readLegacy(error);
+        if (_mappingSize < sizeof(CoRFileHeader))
+            return fail("truncated header", error);
+
+        CoRFileHeader header;
+        std::memcpy(&header, _mapping, sizeof(header));
+        bool swapped = header.endianness != CoRFileHeader::EndiannessMarker;
+        if (swapped) {
+            if (swapBytes(header.endianness) != CoRFileHeader::EndiannessMarker)
+                return fail("unknown byte order", error);
+            header.version = swapBytes(header.version);
+            header.count = swapBytes(header.count);
+            header.stride = swapBytes(header.stride);
+            header.payloadOffset = swapBytes(header.payloadOffset);
+            header.hash = swapBytes(header.hash);
+            header.checksum = swapBytes(header.checksum);
+            header.encoding = swapBytes(header.encoding);
+            header.payloadSize = swapBytes(header.payloadSize);
+        }
+
+        if (header.version != CoRFileHeader::Version)
+            return fail("unsupported version " + std::to_string(header.version), error);
+        if (header.encoding != static_cast<std::uint32_t>(CoREncoding::Float32) && header.encoding != static_cast<std::uint32_t>(CoREncoding::Quantized16))
+            return fail("unsupported encoding " + std::to_string(header.encoding), error);
+        if (header.payloadOffset < sizeof(header) || header.payloadOffset % PayloadAlignment != 0)
+            return fail("malformed header", error);
+        if (header.payloadOffset > _mappingSize || header.payloadSize > _mappingSize - header.payloadOffset)
+            return fail("truncated payload", error);
+
+        const unsigned char *payload = _mapping + header.payloadOffset;
+        if (verifyChecksum && checksum(payload, static_cast<std::size_t>(header.payloadSize)) != header.checksum)
+            return fail("checksum mismatch", error);
+        _hash = header.hash;
+
+        if (header.encoding == static_cast<std::uint32_t>(CoREncoding::Quantized16))
+            return readQuantized(header, swapped, error);
+        if (header.stride < sizeof(glm::vec3) || header.count > header.payloadSize / header.stride)
+            return fail("malformed header", error);
+        std::size_t count = static_cast<std::size_t>(header.count);
+
+        if (!swapped && header.stride == sizeof(glm::vec3)) {
+            _cors.data = reinterpret_cast<const glm::vec3 *>(payload);
+            _cors.size = count;
+            return true;
+        }
+
+        _storage.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::uint32_t components[3];
+            std::memcpy(components, payload + i * header.stride, sizeof(components));
+            if (swapped)
+                for (std::uint32_t &component : components)
+                    component = swapBytes(component);
+            std::memcpy(&_storage[i], components, sizeof(components));
+        }
+        unmap();
+        _cors.data = _storage.data();
+        _cors.size = count;
+        return true;
+    }
+
+    bool MappedCoRFile::readQuantized(const CoRFileHeader &header, bool swapped, std::string *error)
+    {
+        // every value takes at least a bit
+        if (header.count > 8 * header.payloadSize / 3)
+            return fail("malformed header", error);
+
+        const std::uint8_t *payload = _mapping + header.payloadOffset;
+        std::size_t payloadSize = static_cast<std::size_t>(header.payloadSize);
+        // the bit stream is byte ordered, only origin and extent are in the writer's byte order
+        std::vector<std::uint8_t> swappedPayload;
+        if (swapped) {
+            swappedPayload.assign(payload, payload + payloadSize);
+            for (std::size_t offset = 0; offset + sizeof(std::uint32_t) <= std::min(payloadSize, 2 * sizeof(glm::vec3)); offset += sizeof(std::uint32_t)) {
+                std::uint32_t component;
+                std::memcpy(&component, &swappedPayload[offset], sizeof(component));
+                component = swapBytes(component);
+                std::memcpy(&swappedPayload[offset], &component, sizeof(component));
+            }
+            payload = swappedPayload.data();
+        }
+
+        QuantizedCoRs quantized;
+        if (!decodeQuantizedCoRs(payload, payloadSize, static_cast<std::size_t>(header.count), quantized))
+            return fail("malformed quantized payload", error);
+        unmap();
+        _encoding = CoREncoding::Quantized16;
+        _storage = quantized.dequantize();
+        _cors.data = _storage.data();
+        _cors.size = _storage.size();
+        return true;
+    }
+
+    bool MappedCoRFile::readLegacy(std::string *error)
+    {
+        // the count is written with operator<< right before the floats, whose first byte may
+        // look like a digit too, so take the digit prefix that accounts for the file size
+        std::size_t digits = 0;
+        std::uint64_t count = 0;
+        bool found = false;
+        while (digits < _mappingSize && digits < 20 && _mapping[digits] >= '0' && _mapping[digits] <= '9') {
+            count = 10 * count + (_mapping[digits] - '0');
+            ++digits;
+            if (count <= (_mappingSize - digits) / sizeof(glm::vec3) && digits + count * sizeof(glm::vec3) == _mappingSize) {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return fail("not a .cors file", error);
+
+        _storage.resize(static_cast<std::size_t>(count));
+        std::memcpy(_storage.data(), _mapping + digits, _storage.size() * sizeof(glm::vec3));
+        unmap();
+        _legacy = true;
+        _cors.data = _storage.data();
+        _cors.size = _storage.size();
+        return true;
+    }
+
+    void MappedCoRFile::close()
+    {
+        unmap();
+        _storage.clear();
+        _storage.shrink_to_fit();
+        _cors = CoRSpan();
+        _hash = 0;
+        _legacy = false;
+        _encoding = CoREncoding::Float32;
+    }
+
+    bool MappedCoRFile::fail(const std::string &message, std::string *error)
+    {
+        close();
+        if (error)
+            *error = message;
+        return false;
+    }
+
+#ifdef _WIN32
+    bool MappedCoRFile::map(const std::string &path, std::string *error)
+    {
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return fail("cannot open file", error);
+        _fileHandle = file;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+            return fail("empty file", error);
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            return fail("cannot map file", error);
+        _mappingHandle = mapping;
+
+        _mapping = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!_mapping)
+            return fail("cannot map file", error);
+        _mappingSize = static_cast<std::size_t>(size.QuadPart);
+        return true;
+    }
+
+    void MappedCoRFile::unmap()
+    {
+        if (_mapping)
+            UnmapViewOfFile(_mapping);
+        if (_mappingHandle)
+            CloseHandle(_mappingHandle);
+        if (_fileHandle)
+            CloseHandle(_fileHandle);
+        _mapping = nullptr;
+        _mappingSize = 0;
+        _mappingHandle = nullptr;
+        _fileHandle = nullptr;
+    }
+#else
+    bool MappedCoRFile::map(const std::string &path, std::string *error)
+    {
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return fail("cannot open file", error);
+
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size == 0) {
+            ::close(file);
+            return fail("empty file", error);
+        }
+
+        void *mapping = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (mapping == MAP_FAILED)
+            return fail("cannot map file", error);
+        _mapping = static_cast<const unsigned char *>(mapping);
+        _mappingSize = static_cast<std::size_t>(status.st_size);
+        return true;
+    }
+
+    void MappedCoRFile::unmap()
+    {
+        if (_mapping)
+            munmap(const_cast<unsigned char *>(_mapping), _mappingSize);
+        _mapping = nullptr;
+        _mappingSize = 0;
+    }
+#endif
+}
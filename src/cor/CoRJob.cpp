@@ -0,0 +1,57 @@
+#include <cor/CoRJob.h>
+
+#include <chrono>
+
+namespace CoR {
+    CoRJob::CoRJob(unsigned long totalVertices)
+            : _done(0), _total(totalVertices), _resumed(0), _cancelled(false), _finished(false)
+    {
+        _clock.clockStart();
+    }
+
+    float CoRJob::progress() const
+    {
+        unsigned long totalVertices = total();
+        if (totalVertices == 0)
+            return finished() ? 1.0f : 0.0f;
+        return static_cast<float>(done()) / totalVertices;
+    }
+
+    double CoRJob::elapsedSeconds() const
+    {
+        return _clock.elapsedSeconds();
+    }
+
+    double CoRJob::etaSeconds() const
+    {
+        if (finished())
+            return 0;
+        unsigned long doneVertices = done();
+        unsigned long resumedVertices = resumed();
+        // nothing computed in this run yet
+        if (doneVertices <= resumedVertices)
+            return -1;
+        return elapsedSeconds() * (total() - doneVertices) / (doneVertices - resumedVertices);
+    }
+
+    void CoRJob::wait() const
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _finishedCondition.wait(lock, [this] { return finished(); });
+    }
+
+    bool CoRJob::waitFor(double seconds) const
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _finishedCondition.wait_for(lock, std::chrono::duration<double>(seconds), [this] { return finished(); });
+    }
+
+    void CoRJob::finish()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _finished.store(true, std::memory_order_release);
+        }
+        _finishedCondition.notify_all();
+    }
+}
@@ -0,0 +1,238 @@
+#include <cor/CoRQuantization.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+namespace CoR {
+    namespace {
+        const std::size_t BlockSize = 64;
+        const unsigned int ParameterBits = 5;
+        // zigzag mapped deltas of 16 bit values need 17 bits
+        const unsigned int MaxParameter = 17;
+        // a quotient this large is replaced by the raw value
+        const std::uint32_t EscapeQuotient = 24;
+
+        class BitWriter {
+        public:
+            explicit BitWriter(std::vector<std::uint8_t> &bytes) : _bytes(bytes) {
+            }
+
+            void write(std::uint32_t value, unsigned int bits) {
+                for (unsigned int i = 0; i < bits; ++i)
+                    writeBit((value >> i) & 1);
+            }
+
+            void writeOnes(std::uint32_t count) {
+                for (std::uint32_t i = 0; i < count; ++i)
+                    writeBit(1);
+            }
+
+            void writeBit(std::uint32_t bit) {
+                if (_used == 0)
+                    _bytes.push_back(0);
+                _bytes.back() |= static_cast<std::uint8_t>(bit << _used);
+                _used = (_used + 1) & 7;
+            }
+
+        private:
+            std::vector<std::uint8_t> &_bytes;
+            unsigned int _used = 0;
+        };
+
+        class BitReader {
+        public:
+            BitReader(const std::uint8_t *bytes, std::size_t size) : _bytes(bytes), _bits(8 * size) {
+            }
+
+            bool read(unsigned int bits, std::uint32_t &value) {
+                if (_position + bits > _bits)
+                    return false;
+                value = 0;
+                for (unsigned int i = 0; i < bits; ++i, ++_position)
+                    value |= static_cast<std::uint32_t>((_bytes[_position >> 3] >> (_position & 7)) & 1) << i;
+                return true;
+            }
+
+            // counts ones up to the first zero, at most limit of them
+            bool readOnes(std::uint32_t limit, std::uint32_t &count) {
+                count = 0;
+                while (count < limit) {
+                    if (_position >= _bits)
+                        return false;
+                    std::uint32_t bit = (_bytes[_position >> 3] >> (_position & 7)) & 1;
+                    ++_position;
+                    if (!bit)
+                        return true;
+                    ++count;
+                }
+                return true;
+            }
+
+        private:
+            const std::uint8_t *_bytes;
+            std::size_t _bits;
+            std::size_t _position = 0;
+        };
+
+        std::uint32_t zigzag(std::int32_t delta) {
+            return (static_cast<std::uint32_t>(delta) << 1) ^ static_cast<std::uint32_t>(delta >> 31);
+        }
+
+        std::int32_t unzigzag(std::uint32_t value) {
+            return static_cast<std::int32_t>(value >> 1) ^ -static_cast<std::int32_t>(value & 1);
+        }
+
+        std::size_t riceBits(std::uint32_t value, unsigned int parameter) {
+            std::uint32_t quotient = value >> parameter;
+            return quotient < EscapeQuotient ? quotient + 1 + parameter : EscapeQuotient + MaxParameter;
+        }
+
+        void writeRice(BitWriter &writer, std::uint32_t value, unsigned int parameter) {
+            std::uint32_t quotient = value >> parameter;
+            if (quotient < EscapeQuotient) {
+                writer.writeOnes(quotient);
+                writer.writeBit(0);
+                writer.write(value, parameter);
+            } else {
+                writer.writeOnes(EscapeQuotient);
+                writer.write(value, MaxParameter);
+            }
+        }
+
+        bool readRice(BitReader &reader, unsigned int parameter, std::uint32_t &value) {
+            std::uint32_t quotient, remainder;
+            if (!reader.readOnes(EscapeQuotient, quotient))
+                return false;
+            if (quotient == EscapeQuotient)
+                return reader.read(MaxParameter, value);
+            if (!reader.read(parameter, remainder))
+                return false;
+            value = (quotient << parameter) | remainder;
+            return true;
+        }
+    }
+
+    glm::vec3 QuantizedCoRs::dequantize(std::size_t i) const
+    {
+        glm::vec3 q(values[3 * i], values[3 * i + 1], values[3 * i + 2]);
+        return origin + extent * (q / static_cast<float>(Steps));
+    }
+
+    std::vector<glm::vec3> QuantizedCoRs::dequantize() const
+    {
+        std::vector<glm::vec3> cors(size());
+        for (std::size_t i = 0; i < cors.size(); ++i)
+            cors[i] = dequantize(i);
+        return cors;
+    }
+
+    QuantizedCoRs QuantizedCoRs::quantize(const glm::vec3 *cors, std::size_t count)
+    {
+        QuantizedCoRs quantized;
+        quantized.values.resize(3 * count);
+        if (count == 0)
+            return quantized;
+
+        glm::vec3 lower = cors[0], upper = cors[0];
+        for (std::size_t i = 1; i < count; ++i) {
+            lower = glm::min(lower, cors[i]);
+            upper = glm::max(upper, cors[i]);
+        }
+        quantized.origin = lower;
+        quantized.extent = upper - lower;
+
+        for (std::size_t i = 0; i < count; ++i) {
+            for (int axis = 0; axis < 3; ++axis) {
+                float extent = quantized.extent[axis];
+                float t = extent > 0 ? (cors[i][axis] - lower[axis]) / extent : 0;
+                float step = std::floor(std::min(std::max(t, 0.0f), 1.0f) * Steps + 0.5f);
+                quantized.values[3 * i + axis] = static_cast<std::uint16_t>(step);
+            }
+        }
+        return quantized;
+    }
+
+    QuantizationError quantizationError(const glm::vec3 *cors, const QuantizedCoRs &quantized)
+    {
+        QuantizationError error;
+        double sum = 0;
+        for (std::size_t i = 0; i < quantized.size(); ++i) {
+            float displacement = glm::length(quantized.dequantize(i) - cors[i]);
+            error.max = std::max(error.max, displacement);
+            sum += displacement;
+        }
+        if (quantized.size() > 0)
+            error.mean = static_cast<float>(sum / quantized.size());
+        return error;
+    }
+
+    void encodeQuantizedCoRs(const QuantizedCoRs &quantized, std::vector<std::uint8_t> &bytes)
+    {
+        bytes.resize(2 * sizeof(glm::vec3));
+        std::memcpy(bytes.data(), &quantized.origin, sizeof(glm::vec3));
+        std::memcpy(bytes.data() + sizeof(glm::vec3), &quantized.extent, sizeof(glm::vec3));
+
+        const std::size_t count = quantized.size();
+        std::vector<std::uint32_t> deltas(BlockSize);
+        BitWriter writer(bytes);
+        for (int axis = 0; axis < 3; ++axis) {
+            std::int32_t previous = 0;
+            for (std::size_t block = 0; block < count; block += BlockSize) {
+                std::size_t blockCount = std::min(BlockSize, count - block);
+                for (std::size_t i = 0; i < blockCount; ++i) {
+                    std::int32_t value = quantized.values[3 * (block + i) + axis];
+                    deltas[i] = zigzag(value - previous);
+                    previous = value;
+                }
+
+                unsigned int best = 0;
+                std::size_t bestBits = ~std::size_t(0);
+                for (unsigned int parameter = 0; parameter <= MaxParameter; ++parameter) {
+                    std::size_t bits = 0;
+                    for (std::size_t i = 0; i < blockCount; ++i)
+                        bits += riceBits(deltas[i], parameter);
+                    if (bits < bestBits) {
+                        bestBits = bits;
+                        best = parameter;
+                    }
+                }
+
+                writer.write(best, ParameterBits);
+                for (std::size_t i = 0; i < blockCount; ++i)
+                    writeRice(writer, deltas[i], best);
+            }
+        }
+    }
+
+    bool decodeQuantizedCoRs(const std::uint8_t *bytes, std::size_t size, std::size_t count, QuantizedCoRs &quantized)
+    {
+        if (size < 2 * sizeof(glm::vec3))
+            return false;
+        std::memcpy(&quantized.origin, bytes, sizeof(glm::vec3));
+        std::memcpy(&quantized.extent, bytes + sizeof(glm::vec3), sizeof(glm::vec3));
+        quantized.values.resize(3 * count);
+
+        BitReader reader(bytes + 2 * sizeof(glm::vec3), size - 2 * sizeof(glm::vec3));
+        for (int axis = 0; axis < 3; ++axis) {
+            std::int32_t previous = 0;
+            for (std::size_t block = 0; block < count; block += BlockSize) {
+                std::size_t blockCount = std::min(BlockSize, count - block);
+                std::uint32_t parameter, delta;
+                if (!reader.read(ParameterBits, parameter) || parameter > MaxParameter)
+                    return false;
+                for (std::size_t i = 0; i < blockCount; ++i) {
+                    if (!readRice(reader, parameter, delta))
+                        return false;
+                    previous += unzigzag(delta);
+                    if (previous < 0 || previous > static_cast<std::int32_t>(QuantizedCoRs::Steps))
+                        return false;
+                    quantized.values[3 * (block + i) + axis] = static_cast<std::uint16_t>(previous);
+                }
+            }
+        }
+        return true;
+    }
+}
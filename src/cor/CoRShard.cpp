@@ -0,0 +1,128 @@
+#include <cor/CoRShard.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <cor/CoRCheckpoint.h>
+
+namespace CoR {
+    namespace {
+        const char Magic[8] = {'C', 'O', 'R', 'S', 'H', 'R', 'D', '1'};
+        const std::uint32_t Version = 1;
+
+        struct Header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t checksum;
+            std::uint64_t from, to;
+            std::uint64_t vertexCount;
+            std::uint64_t hash;
+        };
+
+        std::uint32_t checksum(const std::vector<glm::vec3> &cors)
+        {
+            Fnv1a fnv;
+            fnv.update(cors.data(), 3 * sizeof(float) * cors.size());
+            return static_cast<std::uint32_t>(fnv.value ^ (fnv.value >> 32));
+        }
+    }
+
+    bool CoRShard::write(const std::string &path) const
+    {
+        Header header;
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.checksum = checksum(cors);
+        header.from = from;
+        header.to = to;
+        header.vertexCount = vertexCount;
+        header.hash = hash;
+
+        std::string partialPath = path + ".partial";
+        {
+            std::ofstream file(partialPath, std::ios::out | std::ios::trunc | std::ios::binary);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(cors.data()), 3 * sizeof(float) * cors.size());
+            if (!file)
+                return false;
+        }
+#ifdef _WIN32
+        // rename does not replace an existing file on Windows
+        std::remove(path.c_str());
+#endif
+        return std::rename(partialPath.c_str(), path.c_str()) == 0;
+    }
+
+    bool CoRShard::read(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        Header header;
+        file.read(reinterpret_cast<char *>(&header), sizeof(header));
+        if (!file || std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version
+            || header.to < header.from || header.to > header.vertexCount)
+            return false;
+
+        // a damaged header must not size the allocation, the payload has to be in the file
+        std::streamoff payloadBegin = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::uint64_t payloadSize = static_cast<std::uint64_t>(static_cast<std::streamoff>(file.tellg()) - payloadBegin);
+        file.seekg(payloadBegin);
+        if (!file || header.to - header.from != payloadSize / (3 * sizeof(float)) || payloadSize % (3 * sizeof(float)) != 0)
+            return false;
+
+        from = header.from;
+        to = header.to;
+        vertexCount = header.vertexCount;
+        hash = header.hash;
+        cors.resize(to - from);
+        file.read(reinterpret_cast<char *>(cors.data()), 3 * sizeof(float) * cors.size());
+        return file && checksum(cors) == header.checksum;
+    }
+
+    bool mergeCoRShards(const std::vector<CoRShard> &shards, std::vector<glm::vec3> &cors, std::string &error)
+    {
+        cors.clear();
+        if (shards.empty()) {
+            error = "no shards";
+            return false;
+        }
+
+        std::vector<const CoRShard *> ordered;
+        for (const CoRShard &shard : shards)
+            ordered.push_back(&shard);
+        std::sort(ordered.begin(), ordered.end(), [](const CoRShard *a, const CoRShard *b) {
+            return a->from < b->from;
+        });
+
+        std::ostringstream message;
+        const CoRShard &first = *ordered.front();
+        std::uint64_t covered = 0;
+        for (const CoRShard *shard : ordered) {
+            if (shard->vertexCount != first.vertexCount || shard->hash != first.hash) {
+                message << "shard [" << shard->from << ", " << shard->to << ") belongs to another bake";
+                error = message.str();
+                return false;
+            }
+            if (shard->from != covered) {
+                message << (shard->from > covered ? "vertices missing: [" : "vertices baked twice: [")
+                        << std::min(covered, shard->from) << ", " << std::max(covered, shard->from) << ")";
+                error = message.str();
+                return false;
+            }
+            covered = shard->to;
+        }
+        if (covered != first.vertexCount) {
+            message << "vertices missing: [" << covered << ", " << first.vertexCount << ")";
+            error = message.str();
+            return false;
+        }
+
+        cors.reserve(first.vertexCount);
+        for (const CoRShard *shard : ordered)
+            cors.insert(cors.end(), shard->cors.begin(), shard->cors.end());
+        return true;
+    }
+}
@@ -0,0 +1,106 @@
+#include <cor/CoRStats.h>
+
+#include <sstream>
+
+namespace CoR {
+    double CoRStats::stageSeconds(const std::string &name) const
+    {
+        for (const StageTime &stage : stages)
+            if (stage.name == name)
+                return stage.seconds;
+        return 0;
+    }
+
+    std::string CoRStats::toJSON() const
+    {
+        std::ostringstream json;
+        json << "{\"vertices\": " << vertices
+             << ", \"weightClasses\": " << weightClasses
+             << ", \"cors\": " << counters.cors
+             << ", \"similarityEvaluations\": " << counters.similarityEvaluations
+             << ", \"trianglesVisited\": " << counters.trianglesVisited
+             << ", \"trianglesPruned\": " << counters.trianglesPruned
+             << ", \"bfsDepthSum\": " << counters.bfsDepthSum
+             << ", \"maxBfsDepth\": " << counters.maxBfsDepth
+             << ", \"edges\": " << edges.edges
+             << ", \"boundaryEdges\": " << edges.boundaryEdges
+             << ", \"nonManifoldEdges\": " << edges.nonManifoldEdges
+             << ", \"stages\": {";
+        for (std::size_t i = 0; i < stages.size(); ++i)
+            json << (i > 0 ? ", " : "") << "\"" << stages[i].name << "\": " << stages[i].seconds;
+        json << "}}";
+        return json.str();
+    }
+
+    CoRStatsCollector::CoRStatsCollector()
+            : _vertices(0), _weightClasses(0),
+              _cors(0), _similarityEvaluations(0), _trianglesVisited(0), _trianglesPruned(0),
+              _bfsDepthSum(0), _maxBfsDepth(0)
+    {
+    }
+
+    void CoRStatsCollector::add(const CoRCounters &counters)
+    {
+        _cors.fetch_add(counters.cors, std::memory_order_relaxed);
+        _similarityEvaluations.fetch_add(counters.similarityEvaluations, std::memory_order_relaxed);
+        _trianglesVisited.fetch_add(counters.trianglesVisited, std::memory_order_relaxed);
+        _trianglesPruned.fetch_add(counters.trianglesPruned, std::memory_order_relaxed);
+        _bfsDepthSum.fetch_add(counters.bfsDepthSum, std::memory_order_relaxed);
+
+        unsigned long depth = _maxBfsDepth.load(std::memory_order_relaxed);
+        while (counters.maxBfsDepth > depth && !_maxBfsDepth.compare_exchange_weak(depth, counters.maxBfsDepth, std::memory_order_relaxed)) {
+        }
+    }
+
+    void CoRStatsCollector::setStage(const std::string &name, double seconds)
+    {
+        std::lock_guard<std::mutex> lock(_stagesMutex);
+        for (StageTime &stage : _stages) {
+            if (stage.name == name) {
+                stage.seconds = seconds;
+                return;
+            }
+        }
+        _stages.push_back(StageTime{name, seconds});
+    }
+
+    void CoRStatsCollector::setSizes(unsigned long vertices, unsigned long weightClasses)
+    {
+        _vertices = vertices;
+        _weightClasses = weightClasses;
+    }
+
+    void CoRStatsCollector::setEdges(const EdgeStatistics &edges)
+    {
+        std::lock_guard<std::mutex> lock(_stagesMutex);
+        _edges = edges;
+    }
+
+    void CoRStatsCollector::resetCounters()
+    {
+        _cors = 0;
+        _similarityEvaluations = 0;
+        _trianglesVisited = 0;
+        _trianglesPruned = 0;
+        _bfsDepthSum = 0;
+        _maxBfsDepth = 0;
+    }
+
+    CoRStats CoRStatsCollector::snapshot() const
+    {
+        CoRStats stats;
+        stats.vertices = _vertices;
+        stats.weightClasses = _weightClasses;
+        stats.counters.cors = _cors;
+        stats.counters.similarityEvaluations = _similarityEvaluations;
+        stats.counters.trianglesVisited = _trianglesVisited;
+        stats.counters.trianglesPruned = _trianglesPruned;
+        stats.counters.bfsDepthSum = _bfsDepthSum;
+        stats.counters.maxBfsDepth = _maxBfsDepth;
+
+        std::lock_guard<std::mutex> lock(_stagesMutex);
+        stats.stages = _stages;
+        stats.edges = _edges;
+        return stats;
+    }
+}
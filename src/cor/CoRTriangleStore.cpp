@@ -0,0 +1,91 @@
+#include <cor/CoRTriangleStore.h>
+
+#include <unordered_map>
+
+namespace CoR {
+    namespace {
+        struct Aggregate {
+            double area;
+            double centerX, centerY, centerZ;
+            unsigned long count;
+        };
+    }
+
+    CoRTriangleStore CoRTriangleStore::aggregated() const
+    {
+        std::unordered_map<WeightsPerBone, unsigned int, WeightsPerBone::Hasher> entryOfWeight;
+        std::vector<WeightsPerBone> entryWeights;
+        std::vector<Aggregate> aggregates;
+
+        for (unsigned long t = 0; t < size(); ++t) {
+            if (weightOffsets[t + 1] - weightOffsets[t] < 2)
+                continue;
+
+            WeightsPerBone w = weight(t);
+            auto inserted = entryOfWeight.insert(std::make_pair(w, static_cast<unsigned int>(aggregates.size())));
+            if (inserted.second) {
+                entryWeights.push_back(w);
+                aggregates.push_back(Aggregate{0, 0, 0, 0, 0});
+            }
+
+            Aggregate &a = aggregates[inserted.first->second];
+            a.area += area[t];
+            a.centerX += static_cast<double>(area[t]) * centerX[t];
+            a.centerY += static_cast<double>(area[t]) * centerY[t];
+            a.centerZ += static_cast<double>(area[t]) * centerZ[t];
+            ++a.count;
+        }
+
+        CoRTriangleStore merged;
+        merged.reserve(aggregates.size());
+        for (unsigned long e = 0; e < aggregates.size(); ++e) {
+            const Aggregate &a = aggregates[e];
+            glm::vec3 center(0);
+            if (a.area > 0)
+                center = glm::vec3(float(a.centerX / a.area), float(a.centerY / a.area), float(a.centerZ / a.area));
+            merged.push_back(center, static_cast<float>(a.area), entryWeights[e]);
+        }
+        return merged;
+    }
+
+    void CoRTriangleStore::setWeights(const std::vector<unsigned int> &entries, const std::vector<WeightsPerBone> &weights)
+    {
+        bool sameCounts = true;
+        for (std::size_t i = 0; i < entries.size() && sameCounts; ++i)
+            sameCounts = weights[i].size() == static_cast<int>(weightOffsets[entries[i] + 1] - weightOffsets[entries[i]]);
+
+        if (sameCounts) {
+            for (std::size_t i = 0; i < entries.size(); ++i) {
+                unsigned int offset = weightOffsets[entries[i]];
+                for (int j = 0; j < weights[i].size(); ++j) {
+                    weightBones[offset + j] = static_cast<unsigned short>(weights[i].bone(j));
+                    weightValues[offset + j] = weights[i].weight(j);
+                }
+            }
+            return;
+        }
+
+        std::vector<unsigned int> offsets(weightOffsets.size(), 0);
+        std::vector<unsigned short> bones;
+        AlignedFloats values;
+        bones.reserve(weightBones.size());
+        values.reserve(weightValues.size());
+        std::size_t next = 0;
+        for (unsigned long t = 0; t < size(); ++t) {
+            if (next < entries.size() && entries[next] == t) {
+                const WeightsPerBone &w = weights[next++];
+                for (int j = 0; j < w.size(); ++j) {
+                    bones.push_back(static_cast<unsigned short>(w.bone(j)));
+                    values.push_back(w.weight(j));
+                }
+            } else {
+                bones.insert(bones.end(), weightBones.begin() + weightOffsets[t], weightBones.begin() + weightOffsets[t + 1]);
+                values.insert(values.end(), weightValues.begin() + weightOffsets[t], weightValues.begin() + weightOffsets[t + 1]);
+            }
+            offsets[t + 1] = static_cast<unsigned int>(bones.size());
+        }
+        weightOffsets.swap(offsets);
+        weightBones.swap(bones);
+        weightValues.swap(values);
+    }
+}
@@ -0,0 +1,208 @@
+#include <cor/MeshSubdivider.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+namespace CoR {
+    namespace {
+        const unsigned int NoMidpoint = ~0u;
+
+        std::uint64_t edgeKey(unsigned int a, unsigned int b)
+        {
+            if (a > b)
+                std::swap(a, b);
+            return (std::uint64_t(a) << 32) | b;
+        }
+
+        struct SplitCandidate {
+            std::uint64_t edge;
+            float distance;
+            // number of triangle sides on this edge, each gains one triangle when it splits
+            unsigned int sides;
+        };
+    }
+
+    MeshSubdivider::MeshSubdivider(float epsilon, const SubdivisionLimits &limits, ThreadPool *pool)
+            : _epsilon(epsilon), _limits(limits), _pool(pool)
+    {
+    }
+
+    void MeshSubdivider::parallelFor(unsigned long begin, unsigned long end, const ThreadPool::RangeFunction &body) const
+    {
+        if (_pool)
+            _pool->parallelFor(begin, end, 0, body);
+        else
+            body(begin, end);
+    }
+
+    unsigned long MeshSubdivider::subdivide(std::vector<glm::vec3> &vertices, std::vector<unsigned int> &indices, std::vector<WeightsPerBone> &weights) const
+    {
+        const unsigned long maxVertices = static_cast<unsigned long>(_limits.maxVertexGrowth * vertices.size());
+        const unsigned long maxTriangles = static_cast<unsigned long>(_limits.maxTriangleGrowth * (indices.size() / 3));
+        unsigned long splitEdges = 0;
+
+        for (unsigned int pass = 0; pass < _limits.maxPasses; ++pass) {
+            const unsigned long triangleCount = indices.size() / 3;
+            const unsigned long blockSize = 4096;
+            const unsigned long blockCount = (triangleCount + blockSize - 1) / blockSize;
+
+            // 1.) edge sides that are too long in weight space, gathered per block of triangles
+            std::vector<std::vector<SplitCandidate>> blockCandidates(blockCount);
+            parallelFor(0, blockCount, [&](unsigned long fromBlock, unsigned long toBlock) {
+                for (unsigned long b = fromBlock; b < toBlock; ++b) {
+                    for (unsigned long t = b * blockSize; t < std::min(triangleCount, (b + 1) * blockSize); ++t) {
+                        for (int e = 0; e < 3; ++e) {
+                            unsigned int v0 = indices[3 * t + e];
+                            unsigned int v1 = indices[3 * t + (e + 1) % 3];
+                            if (v0 == v1)
+                                continue;
+                            float distance = skinningWeightsDistance(weights[v0], weights[v1]);
+                            if (distance >= _epsilon)
+                                blockCandidates[b].push_back(SplitCandidate{edgeKey(v0, v1), distance, 1});
+                        }
+                    }
+                }
+            });
+
+            std::vector<SplitCandidate> candidates;
+            for (std::vector<SplitCandidate> &block : blockCandidates)
+                candidates.insert(candidates.end(), block.begin(), block.end());
+            if (candidates.empty())
+                break;
+
+            // one candidate per undirected edge
+            std::sort(candidates.begin(), candidates.end(), [](const SplitCandidate &a, const SplitCandidate &b) {
+                return a.edge < b.edge;
+            });
+            unsigned long unique = 0;
+            for (unsigned long i = 0; i < candidates.size(); ++i) {
+                if (unique > 0 && candidates[unique - 1].edge == candidates[i].edge)
+                    ++candidates[unique - 1].sides;
+                else
+                    candidates[unique++] = candidates[i];
+            }
+            candidates.resize(unique);
+
+            // 2.) respect the growth caps, splitting the most dissimilar edges first
+            unsigned long vertexBudget = maxVertices > vertices.size() ? maxVertices - vertices.size() : 0;
+            unsigned long triangleBudget = maxTriangles > triangleCount ? maxTriangles - triangleCount : 0;
+            unsigned long totalSides = 0;
+            for (const SplitCandidate &c : candidates)
+                totalSides += c.sides;
+
+            bool capped = candidates.size() > vertexBudget || totalSides > triangleBudget;
+            if (capped) {
+                std::stable_sort(candidates.begin(), candidates.end(), [](const SplitCandidate &a, const SplitCandidate &b) {
+                    return a.distance > b.distance;
+                });
+                unsigned long kept = 0;
+                for (const SplitCandidate &c : candidates) {
+                    if (vertexBudget == 0 || c.sides > triangleBudget)
+                        continue;
+                    --vertexBudget;
+                    triangleBudget -= c.sides;
+                    candidates[kept++] = c;
+                }
+                candidates.resize(kept);
+                std::sort(candidates.begin(), candidates.end(), [](const SplitCandidate &a, const SplitCandidate &b) {
+                    return a.edge < b.edge;
+                });
+            }
+            if (candidates.empty())
+                break;
+
+            // 3.) one midpoint per edge, shared by all triangles on it
+            const unsigned long firstMidpoint = vertices.size();
+            std::unordered_map<std::uint64_t, unsigned int> midpointOfEdge;
+            midpointOfEdge.reserve(candidates.size());
+            for (unsigned long i = 0; i < candidates.size(); ++i)
+                midpointOfEdge[candidates[i].edge] = static_cast<unsigned int>(firstMidpoint + i);
+
+            vertices.resize(firstMidpoint + candidates.size());
+            weights.resize(firstMidpoint + candidates.size());
+            parallelFor(0, candidates.size(), [&](unsigned long from, unsigned long to) {
+                for (unsigned long i = from; i < to; ++i) {
+                    unsigned int v0 = static_cast<unsigned int>(candidates[i].edge >> 32);
+                    unsigned int v1 = static_cast<unsigned int>(candidates[i].edge);
+                    vertices[firstMidpoint + i] = 0.5f * (vertices[v0] + vertices[v1]);
+                    weights[firstMidpoint + i] = (weights[v0] + weights[v1]) * 0.5f;
+                }
+            });
+
+            // 4.) split every triangle into 1 + (number of split edges) triangles
+            std::vector<unsigned int> midpoints(3 * triangleCount);
+            std::vector<unsigned long> firstOutput(triangleCount + 1, 0);
+            parallelFor(0, triangleCount, [&](unsigned long from, unsigned long to) {
+                for (unsigned long t = from; t < to; ++t) {
+                    unsigned int splits = 0;
+                    for (int e = 0; e < 3; ++e) {
+                        auto found = midpointOfEdge.find(edgeKey(indices[3 * t + e], indices[3 * t + (e + 1) % 3]));
+                        midpoints[3 * t + e] = found == midpointOfEdge.end() ? NoMidpoint : found->second;
+                        splits += found != midpointOfEdge.end();
+                    }
+                    firstOutput[t + 1] = 1 + splits;
+                }
+            });
+            for (unsigned long t = 0; t < triangleCount; ++t)
+                firstOutput[t + 1] += firstOutput[t];
+
+            std::vector<unsigned int> refined(3 * firstOutput.back());
+            parallelFor(0, triangleCount, [&](unsigned long from, unsigned long to) {
+                for (unsigned long t = from; t < to; ++t) {
+                    unsigned int *out = refined.data() + 3 * firstOutput[t];
+                    auto emit = [&out](unsigned int a, unsigned int b, unsigned int c) {
+                        *out++ = a;
+                        *out++ = b;
+                        *out++ = c;
+                    };
+
+                    // rotate so that edge 0 is split and, with two splits, edge 2 is not
+                    int r = 0;
+                    unsigned int splits = static_cast<unsigned int>(firstOutput[t + 1] - firstOutput[t] - 1);
+                    while (splits > 0 && splits < 3 && (midpoints[3 * t + r] == NoMidpoint || (splits == 2 && midpoints[3 * t + (r + 2) % 3] != NoMidpoint)))
+                        ++r;
+
+                    unsigned int v0 = indices[3 * t + r], v1 = indices[3 * t + (r + 1) % 3], v2 = indices[3 * t + (r + 2) % 3];
+                    unsigned int m0 = midpoints[3 * t + r], m1 = midpoints[3 * t + (r + 1) % 3], m2 = midpoints[3 * t + (r + 2) % 3];
+                    switch (splits) {
+                        case 0:
+                            emit(v0, v1, v2);
+                            break;
+                        case 1:
+                            emit(v0, m0, v2);
+                            emit(m0, v1, v2);
+                            break;
+                        case 2:
+                            emit(m0, v1, m1);
+                            emit(v0, m0, m1);
+                            emit(v0, m1, v2);
+                            break;
+                        default:
+                            emit(v0, m0, m2);
+                            emit(m0, v1, m1);
+                            emit(m2, m1, v2);
+                            emit(m0, m1, m2);
+                            break;
+                    }
+                }
+            });
+            indices.swap(refined);
+            splitEdges += candidates.size();
+
+#ifdef COR_ENABLE_PROFILING
+            std::cout << "\tSubdivision pass " << pass << ": split " << candidates.size() << " edges, "
+                      << vertices.size() << " vertices, " << indices.size() / 3 << " triangles" << std::endl;
+#endif
+            if (capped) {
+#ifdef COR_ENABLE_PROFILING
+                std::cout << "\tSubdivision stopped at its growth cap" << std::endl;
+#endif
+                break;
+            }
+        }
+
+        return splitEdges;
+    }
+}
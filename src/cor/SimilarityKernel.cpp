@@ -0,0 +1,416 @@
+#include <cor/SimilarityKernel.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define COR_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define COR_TARGET_AVX2
+#else
+#define COR_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace CoR {
+    namespace {
+        typedef SimilarityKernel::PairTable PairTable;
+        const int BatchSize = SimilarityKernel::BatchSize;
+
+        // K rows for the vertex bones, one column per triangle of the batch
+        template <int K>
+        struct Columns {
+            typedef float Type[K][BatchSize];
+        };
+
+        // sums the bone pairs over the gathered rows, whatever K the columns were gathered for
+        typedef void (*BatchFunction)(const PairTable &pairs, const float (*columns)[BatchSize], float negInvSigmaSquared, float *simOut);
+
+#ifndef COR_SIMD_X86
+        void sumPairsScalar(const PairTable &pairs, const float (*columns)[BatchSize], float negInvSigmaSquared, float *simOut)
+        {
+            for (int l = 0; l < BatchSize; ++l)
+                simOut[l] = 0;
+
+            for (int p = 0; p < pairs.count; ++p) {
+                const float *tj = columns[pairs.j[p]];
+                const float *tk = columns[pairs.k[p]];
+                for (int l = 0; l < BatchSize; ++l) {
+                    float x = pairs.aj[p] * tk[l] - pairs.ak[p] * tj[l];
+                    simOut[l] += pairs.coefficient[p] * tj[l] * tk[l] * std::exp(x * x * negInvSigmaSquared);
+                }
+            }
+        }
+#else
+        // Cephes expf: exp(x) = 2^n * exp(r) with |r| <= ln(2)/2 and a degree 7 polynomial for exp(r)
+        const float ExpLowerBound = -87.3365447f;
+        const float Log2e = 1.44269504088896341f;
+        const float Ln2Hi = 0.693359375f;
+        const float Ln2Lo = -2.12194440e-4f;
+        const float ExpP0 = 1.9875691500E-4f;
+        const float ExpP1 = 1.3981999507E-3f;
+        const float ExpP2 = 8.3334519073E-3f;
+        const float ExpP3 = 4.1665795894E-2f;
+        const float ExpP4 = 1.6666665459E-1f;
+        const float ExpP5 = 5.0000001201E-1f;
+
+        inline __m128 expNegSSE(__m128 x)
+        {
+            x = _mm_max_ps(x, _mm_set1_ps(ExpLowerBound));
+
+            // n = floor(x * log2(e) + 0.5)
+            __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(Log2e)), _mm_set1_ps(0.5f));
+            __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+            n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, fx), _mm_set1_ps(1.0f)));
+
+            __m128 r = _mm_sub_ps(x, _mm_mul_ps(n, _mm_set1_ps(Ln2Hi)));
+            r = _mm_sub_ps(r, _mm_mul_ps(n, _mm_set1_ps(Ln2Lo)));
+            __m128 r2 = _mm_mul_ps(r, r);
+
+            __m128 y = _mm_set1_ps(ExpP0);
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(ExpP1));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(ExpP2));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(ExpP3));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(ExpP4));
+            y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(ExpP5));
+            y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, r2), r), _mm_set1_ps(1.0f));
+
+            __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+            return _mm_mul_ps(y, _mm_castsi128_ps(e));
+        }
+
+        void sumPairsSSE(const PairTable &pairs, const float (*columns)[BatchSize], float negInvSigmaSquared, float *simOut)
+        {
+            __m128 negInv = _mm_set1_ps(negInvSigmaSquared);
+            for (int half = 0; half < BatchSize; half += 4) {
+                __m128 sim = _mm_setzero_ps();
+                for (int p = 0; p < pairs.count; ++p) {
+                    __m128 tj = _mm_load_ps(columns[pairs.j[p]] + half);
+                    __m128 tk = _mm_load_ps(columns[pairs.k[p]] + half);
+                    __m128 x = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(pairs.aj[p]), tk), _mm_mul_ps(_mm_set1_ps(pairs.ak[p]), tj));
+                    __m128 e = expNegSSE(_mm_mul_ps(_mm_mul_ps(x, x), negInv));
+                    __m128 term = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(pairs.coefficient[p]), tj), tk);
+                    sim = _mm_add_ps(sim, _mm_mul_ps(term, e));
+                }
+                _mm_storeu_ps(simOut + half, sim);
+            }
+        }
+
+        COR_TARGET_AVX2 inline __m256 expNegAVX2(__m256 x)
+        {
+            x = _mm256_max_ps(x, _mm256_set1_ps(ExpLowerBound));
+
+            __m256 n = _mm256_floor_ps(_mm256_fmadd_ps(x, _mm256_set1_ps(Log2e), _mm256_set1_ps(0.5f)));
+
+            __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(Ln2Hi), x);
+            r = _mm256_fnmadd_ps(n, _mm256_set1_ps(Ln2Lo), r);
+            __m256 r2 = _mm256_mul_ps(r, r);
+
+            __m256 y = _mm256_set1_ps(ExpP0);
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(ExpP1));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(ExpP2));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(ExpP3));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(ExpP4));
+            y = _mm256_fmadd_ps(y, r, _mm256_set1_ps(ExpP5));
+            y = _mm256_add_ps(_mm256_fmadd_ps(y, r2, r), _mm256_set1_ps(1.0f));
+
+            __m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvttps_epi32(n), _mm256_set1_epi32(127)), 23);
+            return _mm256_mul_ps(y, _mm256_castsi256_ps(e));
+        }
+
+        COR_TARGET_AVX2 void sumPairsAVX2(const PairTable &pairs, const float (*columns)[BatchSize], float negInvSigmaSquared, float *simOut)
+        {
+            __m256 negInv = _mm256_set1_ps(negInvSigmaSquared);
+            __m256 sim = _mm256_setzero_ps();
+            for (int p = 0; p < pairs.count; ++p) {
+                __m256 tj = _mm256_load_ps(columns[pairs.j[p]]);
+                __m256 tk = _mm256_load_ps(columns[pairs.k[p]]);
+                __m256 x = _mm256_fmsub_ps(_mm256_set1_ps(pairs.aj[p]), tk, _mm256_mul_ps(_mm256_set1_ps(pairs.ak[p]), tj));
+                __m256 e = expNegAVX2(_mm256_mul_ps(_mm256_mul_ps(x, x), negInv));
+                __m256 term = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(pairs.coefficient[p]), tj), tk);
+                sim = _mm256_fmadd_ps(term, e, sim);
+            }
+            _mm256_storeu_ps(simOut, sim);
+        }
+
+        bool cpuSupportsAVX2()
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7)
+                return false;
+            __cpuid(info, 1);
+            bool fma = (info[2] & (1 << 12)) != 0;
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+                return false;
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        }
+#endif
+
+        struct Dispatch {
+            BatchFunction sumPairs;
+            const char *name;
+
+#ifdef COR_SIMD_X86
+            Dispatch() : Dispatch(cpuSupportsAVX2()) {}
+
+            explicit Dispatch(bool avx2) : sumPairs(avx2 ? &sumPairsAVX2 : &sumPairsSSE), name(avx2 ? "avx2" : "sse2") {}
+#else
+            Dispatch() : sumPairs(&sumPairsScalar), name("scalar") {}
+#endif
+        };
+
+        const Dispatch &dispatch()
+        {
+            static const Dispatch d;
+            return d;
+        }
+
+        // lane accessors returning the sorted sparse weight of the i-th scored triangle
+        struct PointerSource {
+            const WeightsPerBone * const *weights;
+
+            explicit PointerSource(const WeightsPerBone * const *weights) : weights(weights) {}
+
+            int lane(unsigned int i, const unsigned short *&bones, const float *&values) const {
+                bones = weights[i]->bones;
+                values = weights[i]->weights;
+                return weights[i]->count;
+            }
+        };
+
+        struct StoreRangeSource {
+            const CoRTriangleStore &store;
+            unsigned long first;
+
+            StoreRangeSource(const CoRTriangleStore &store, unsigned long first) : store(store), first(first) {}
+
+            int lane(unsigned int i, const unsigned short *&bones, const float *&values) const {
+                unsigned int begin = store.weightOffsets[first + i];
+                bones = store.weightBones.data() + begin;
+                values = store.weightValues.data() + begin;
+                return static_cast<int>(store.weightOffsets[first + i + 1] - begin);
+            }
+        };
+
+        struct StoreIndexSource {
+            const CoRTriangleStore &store;
+            const unsigned int *triangles;
+
+            StoreIndexSource(const CoRTriangleStore &store, const unsigned int *triangles) : store(store), triangles(triangles) {}
+
+            int lane(unsigned int i, const unsigned short *&bones, const float *&values) const {
+                unsigned int begin = store.weightOffsets[triangles[i]];
+                bones = store.weightBones.data() + begin;
+                values = store.weightValues.data() + begin;
+                return static_cast<int>(store.weightOffsets[triangles[i] + 1] - begin);
+            }
+        };
+
+        // merges the sorted bone lists of vertex and triangle
+        template <int K>
+        struct MergeGather {
+            const PairTable &pairs;
+
+            explicit MergeGather(const PairTable &pairs) : pairs(pairs) {}
+
+            // copies the triangle weights of the vertex bones into a column, returns the number of shared bones
+            int operator () (const unsigned short *tBones, const float *tWeights, int tCount, typename Columns<K>::Type &columns, int lane) const {
+                for (int i = 0; i < pairs.boneCount; ++i)
+                    columns[i][lane] = 0;
+
+                int shared = 0;
+                for (int i = 0, j = 0; i < pairs.boneCount && j < tCount;) {
+                    if (pairs.bones[i] < tBones[j]) {
+                        ++i;
+                    } else if (tBones[j] < pairs.bones[i]) {
+                        ++j;
+                    } else {
+                        columns[i++][lane] = tWeights[j++];
+                        ++shared;
+                    }
+                }
+                return shared;
+            }
+        };
+
+        template <int K>
+        struct LaneGather {
+            typedef MergeGather<K> Type;
+        };
+
+#ifdef COR_SIMD_X86
+        /**
+         * Branch-free MergeGather for few vertex bones: they are padded to K and kept
+         * in K / 4 registers, and every triangle bone is compared against all of them
+         * at once. Beyond 8 bones the compares cost more than the merge saves.
+         */
+        template <int K>
+        struct RegisterGather {
+            __m128i bones[K / 4];
+
+            explicit RegisterGather(const PairTable &pairs) {
+                alignas(16) int padded[K];
+                for (int i = 0; i < K; ++i)
+                    padded[i] = i < pairs.boneCount ? pairs.bones[i] : -1;
+                for (int q = 0; q < K / 4; ++q)
+                    bones[q] = _mm_load_si128(reinterpret_cast<const __m128i *>(padded + 4 * q));
+            }
+
+            int operator () (const unsigned short *tBones, const float *tWeights, int tCount, typename Columns<K>::Type &columns, int lane) const {
+                __m128 rows[K / 4];
+                __m128i matches = _mm_setzero_si128();
+                for (int q = 0; q < K / 4; ++q)
+                    rows[q] = _mm_setzero_ps();
+
+                for (int j = 0; j < tCount; ++j) {
+                    __m128i bone = _mm_set1_epi32(tBones[j]);
+                    __m128 weight = _mm_set1_ps(tWeights[j]);
+                    for (int q = 0; q < K / 4; ++q) {
+                        __m128i match = _mm_cmpeq_epi32(bones[q], bone);
+                        rows[q] = _mm_or_ps(rows[q], _mm_and_ps(_mm_castsi128_ps(match), weight));
+                        matches = _mm_sub_epi32(matches, match);
+                    }
+                }
+
+                alignas(16) float values[K];
+                for (int q = 0; q < K / 4; ++q)
+                    _mm_store_ps(values + 4 * q, rows[q]);
+                for (int i = 0; i < K; ++i)
+                    columns[i][lane] = values[i];
+
+                alignas(16) int counts[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(counts), matches);
+                return counts[0] + counts[1] + counts[2] + counts[3];
+            }
+        };
+
+        template <>
+        struct LaneGather<SimilarityKernel::NarrowInfluences> {
+            typedef RegisterGather<SimilarityKernel::NarrowInfluences> Type;
+        };
+
+        template <>
+        struct LaneGather<SimilarityKernel::MediumInfluences> {
+            typedef RegisterGather<SimilarityKernel::MediumInfluences> Type;
+        };
+#endif
+
+        template <int K, typename Source>
+        void evaluateBatches(BatchFunction sumPairs, const PairTable &pairs, float negInvSigmaSquared, const Source &source, unsigned int count, float *simOut)
+        {
+            const typename LaneGather<K>::Type gather(pairs);
+            alignas(32) typename Columns<K>::Type columns;
+            float batchSim[BatchSize];
+
+            for (unsigned int first = 0; first < count; first += BatchSize) {
+                int lanes = count - first < BatchSize ? count - first : BatchSize;
+                if (lanes < BatchSize)
+                    std::memset(columns, 0, sizeof(columns));
+
+                // gather the triangle weights of the vertex bones, column by column
+                bool anyPair = false;
+                for (int l = 0; l < lanes; ++l) {
+                    const unsigned short *tBones;
+                    const float *tWeights;
+                    int tCount = source.lane(first + l, tBones, tWeights);
+                    anyPair |= gather(tBones, tWeights, tCount, columns, l) >= 2;
+                }
+
+                if (!anyPair) {
+                    std::memset(simOut + first, 0, lanes * sizeof(float));
+                    continue;
+                }
+
+                sumPairs(pairs, columns, negInvSigmaSquared, batchSim);
+                for (int l = 0; l < lanes; ++l)
+                    simOut[first + l] = batchSim[l];
+            }
+        }
+
+        // runs the specialization for the influence count chosen by setVertex
+        template <typename Source>
+        void evaluateSpecialized(int influences, const PairTable &pairs, float negInvSigmaSquared, const Source &source, unsigned int count, float *simOut)
+        {
+            if (pairs.count == 0) {
+                // a single influence never forms a bone pair
+                std::memset(simOut, 0, count * sizeof(float));
+                return;
+            }
+
+            BatchFunction sumPairs = dispatch().sumPairs;
+            if (influences == SimilarityKernel::NarrowInfluences)
+                evaluateBatches<SimilarityKernel::NarrowInfluences>(sumPairs, pairs, negInvSigmaSquared, source, count, simOut);
+            else if (influences == SimilarityKernel::MediumInfluences)
+                evaluateBatches<SimilarityKernel::MediumInfluences>(sumPairs, pairs, negInvSigmaSquared, source, count, simOut);
+            else
+                evaluateBatches<SimilarityKernel::WideInfluences>(sumPairs, pairs, negInvSigmaSquared, source, count, simOut);
+        }
+    }
+
+    int SimilarityKernel::specialization(int influences)
+    {
+        if (influences <= NarrowInfluences)
+            return NarrowInfluences;
+        if (influences <= MediumInfluences)
+            return MediumInfluences;
+        return WideInfluences;
+    }
+
+    SimilarityKernel::SimilarityKernel(float sigma, int maxInfluences)
+            : _negInvSigmaSquared(-1.0f / (sigma * sigma)), _maxInfluences(maxInfluences), _influences(specialization(maxInfluences))
+    {
+        _pairs.count = 0;
+        _pairs.boneCount = 0;
+    }
+
+    void SimilarityKernel::setVertex(const WeightsPerBone &weight)
+    {
+        // a vertex beyond the mesh maximum still gets a specialization wide enough
+        _influences = specialization(std::max(_maxInfluences, weight.size()));
+
+        _pairs.boneCount = weight.size();
+        _pairs.count = 0;
+        for (int j = 0; j < weight.size(); ++j) {
+            _pairs.bones[j] = weight.bones[j];
+            for (int k = j + 1; k < weight.size(); ++k) {
+                int p = _pairs.count++;
+                _pairs.j[p] = static_cast<unsigned char>(j);
+                _pairs.k[p] = static_cast<unsigned char>(k);
+                _pairs.aj[p] = weight.weights[j];
+                _pairs.ak[p] = weight.weights[k];
+                _pairs.coefficient[p] = 2 * weight.weights[j] * weight.weights[k];
+            }
+        }
+    }
+
+    void SimilarityKernel::evaluate(const WeightsPerBone * const *weights, unsigned int count, float *simOut) const
+    {
+        evaluateSpecialized(_influences, _pairs, _negInvSigmaSquared, PointerSource(weights), count, simOut);
+    }
+
+    void SimilarityKernel::evaluate(const CoRTriangleStore &store, unsigned long first, unsigned int count, float *simOut) const
+    {
+        evaluateSpecialized(_influences, _pairs, _negInvSigmaSquared, StoreRangeSource(store, first), count, simOut);
+    }
+
+    void SimilarityKernel::evaluateIndexed(const CoRTriangleStore &store, const unsigned int *triangles, unsigned int count, float *simOut) const
+    {
+        evaluateSpecialized(_influences, _pairs, _negInvSigmaSquared, StoreIndexSource(store, triangles), count, simOut);
+    }
+
+    const char * SimilarityKernel::instructionSet()
+    {
+        return dispatch().name;
+    }
+}
@@ -0,0 +1,192 @@
+#include <cor/ThreadPool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace CoR {
+    namespace {
+        // pool and queue index of the calling thread if it is a worker
+        thread_local const ThreadPool *currentPool = nullptr;
+        thread_local unsigned int currentWorker = 0;
+
+        void pinToCore(std::thread &thread, int cpu)
+        {
+#if defined(_WIN32)
+            SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << cpu);
+#elif defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+            (void) thread;
+            (void) cpu;
+#endif
+        }
+    }
+
+    struct ThreadPool::TaskGroup {
+        std::atomic<unsigned long> remaining;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    ThreadPool::ThreadPool(unsigned int workerCount, const std::vector<int> &cpuAffinity)
+            : _queued(0), _stop(false)
+    {
+        if (workerCount == 0)
+            workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+        for (unsigned int i = 0; i < workerCount; ++i)
+            _queues.push_back(std::unique_ptr<Queue>(new Queue()));
+
+        for (unsigned int i = 0; i < workerCount; ++i) {
+            _workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+            if (!cpuAffinity.empty())
+                pinToCore(_workers.back(), cpuAffinity[i % cpuAffinity.size()]);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            _stop = true;
+        }
+        _wakeUp.notify_all();
+        for (std::thread &worker : _workers)
+            worker.join();
+    }
+
+    std::shared_ptr<ThreadPool> ThreadPool::shared()
+    {
+        static std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>();
+        return pool;
+    }
+
+    void ThreadPool::parallelFor(unsigned long begin, unsigned long end, unsigned long grainSize, const RangeFunction &body)
+    {
+        if (begin >= end)
+            return;
+
+        const unsigned long count = end - begin;
+        const unsigned int workerCount = size();
+        if (grainSize == 0)
+            grainSize = std::max(1ul, count / (16ul * workerCount));
+        const unsigned long chunks = (count + grainSize - 1) / grainSize;
+
+        TaskGroup group;
+        group.remaining = chunks;
+
+        // hand every worker a contiguous block of chunks, idle workers steal the rest
+        _queued += static_cast<long>(chunks);
+        for (unsigned int w = 0; w < workerCount; ++w) {
+            unsigned long firstChunk = chunks * w / workerCount;
+            unsigned long lastChunk = chunks * (w + 1) / workerCount;
+            if (firstChunk == lastChunk)
+                continue;
+
+            std::lock_guard<std::mutex> lock(_queues[w]->mutex);
+            for (unsigned long c = firstChunk; c < lastChunk; ++c) {
+                unsigned long from = begin + c * grainSize;
+                _queues[w]->tasks.push_back(Task{&group, from, std::min(from + grainSize, end), &body});
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+        }
+        _wakeUp.notify_all();
+
+        // help out until every chunk of the group is done
+        const bool isWorker = currentPool == this;
+        while (group.remaining > 0) {
+            Task task;
+            if ((isWorker && tryPop(currentWorker, task)) || trySteal(isWorker ? currentWorker : 0, task)) {
+                run(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(group.mutex);
+            group.done.wait_for(lock, std::chrono::milliseconds(1), [&group] { return group.remaining == 0; });
+        }
+
+        // the last worker may still hold the lock while notifying
+        std::lock_guard<std::mutex> lock(group.mutex);
+        if (group.error)
+            std::rethrow_exception(group.error);
+    }
+
+    void ThreadPool::workerLoop(unsigned int index)
+    {
+        currentPool = this;
+        currentWorker = index;
+
+        while (true) {
+            Task task;
+            if (tryPop(index, task) || trySteal(index, task)) {
+                run(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _wakeUp.wait(lock, [this] { return _stop || _queued > 0; });
+            if (_stop && _queued == 0)
+                return;
+        }
+    }
+
+    bool ThreadPool::tryPop(unsigned int index, Task &task)
+    {
+        Queue &queue = *_queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            return false;
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        --_queued;
+        return true;
+    }
+
+    bool ThreadPool::trySteal(unsigned int thief, Task &task)
+    {
+        const unsigned int workerCount = size();
+        for (unsigned int k = 1; k <= workerCount; ++k) {
+            Queue &queue = *_queues[(thief + k) % workerCount];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            --_queued;
+            return true;
+        }
+        return false;
+    }
+
+    void ThreadPool::run(const Task &task)
+    {
+        TaskGroup &group = *task.group;
+        try {
+            (*task.body)(task.from, task.to);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(group.mutex);
+            if (!group.error)
+                group.error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(group.mutex);
+        if (--group.remaining == 0)
+            group.done.notify_all();
+    }
+}
@@ -0,0 +1,161 @@
+#include <cor/WeightClasses.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace CoR {
+    void WeightClasses::build(const std::vector<WeightsPerBone> &weights)
+    {
+        unsigned long vertexCount = weights.size();
+        classOfVertex.resize(vertexCount);
+
+        classOfWeight.clear();
+        classOfWeight.reserve(vertexCount / 4 + 1);
+        weightOfClass.clear();
+
+        std::vector<unsigned int> counts;
+        for (unsigned long v = 0; v < vertexCount; ++v) {
+            auto inserted = classOfWeight.insert(std::make_pair(weights[v], static_cast<unsigned int>(counts.size())));
+            if (inserted.second) {
+                counts.push_back(0);
+                weightOfClass.push_back(weights[v]);
+            }
+            classOfVertex[v] = inserted.first->second;
+            ++counts[classOfVertex[v]];
+        }
+
+        // counting sort of the vertices by class
+        offsets.assign(counts.size() + 1, 0);
+        for (unsigned long c = 0; c < counts.size(); ++c)
+            offsets[c + 1] = offsets[c] + counts[c];
+
+        vertices.resize(vertexCount);
+        std::vector<unsigned int> next(offsets.begin(), offsets.end() - 1);
+        for (unsigned long v = 0; v < vertexCount; ++v)
+            vertices[next[classOfVertex[v]]++] = static_cast<unsigned int>(v);
+    }
+
+    bool WeightClasses::update(const std::vector<WeightsPerBone> &weights, const std::vector<unsigned int> &changedVertices,
+                               std::vector<unsigned int> &changedClasses)
+    {
+        const unsigned int classCount = static_cast<unsigned int>(size());
+        const unsigned int none = ~0u;
+        const std::size_t firstChanged = changedClasses.size();
+
+        // moving vertices grouped by new weight, with the class they came from if it is the same for all
+        struct Group {
+            std::vector<unsigned int> vertices;
+            unsigned int source;
+            unsigned int target;
+        };
+        std::vector<Group> groups;
+        std::unordered_map<WeightsPerBone, unsigned int, WeightsPerBone::Hasher> groupOfWeight;
+        std::unordered_map<unsigned int, unsigned int> leaving;
+        std::vector<unsigned int> changed(changedVertices);
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        for (unsigned int v : changed) {
+            // a vertex that kept its weight stays where it is
+            if (weights[v] == weightOfClass[classOfVertex[v]])
+                continue;
+            auto inserted = groupOfWeight.insert(std::make_pair(weights[v], static_cast<unsigned int>(groups.size())));
+            if (inserted.second)
+                groups.push_back(Group{std::vector<unsigned int>(), classOfVertex[v], none});
+            Group &group = groups[inserted.first->second];
+            if (group.source != classOfVertex[v])
+                group.source = none;
+            group.vertices.push_back(v);
+            ++leaving[classOfVertex[v]];
+        }
+
+        // a weight that has a class joins it, which also keeps that class from being emptied
+        std::vector<bool> claimed(classCount, false);
+        for (Group &group : groups) {
+            auto existing = classOfWeight.find(weights[group.vertices.front()]);
+            if (existing != classOfWeight.end()) {
+                group.target = existing->second;
+                claimed[group.target] = true;
+            }
+        }
+        // emptied classes lose their weight
+        for (const auto &left : leaving) {
+            unsigned int c = left.first;
+            if (left.second == count(c) && !claimed[c])
+                classOfWeight.erase(weightOfClass[c]);
+        }
+        // of the other weights, a class that moved as a whole keeps its id and the rest become new classes
+        unsigned int nextClass = classCount;
+        for (Group &group : groups) {
+            if (group.target == none) {
+                const WeightsPerBone &weight = weights[group.vertices.front()];
+                if (group.source != none && !claimed[group.source] && leaving[group.source] == count(group.source)
+                    && group.vertices.size() == count(group.source)) {
+                    group.target = group.source;
+                    claimed[group.source] = true;
+                    weightOfClass[group.target] = weight;
+                } else {
+                    group.target = nextClass++;
+                    weightOfClass.push_back(weight);
+                }
+                classOfWeight[weight] = group.target;
+            }
+            changedClasses.push_back(group.target);
+            for (unsigned int v : group.vertices)
+                classOfVertex[v] = group.target;
+        }
+        std::sort(changedClasses.begin() + firstChanged, changedClasses.end());
+
+        std::vector<unsigned int> newOffsets(nextClass + 1, 0);
+        for (unsigned int c = 0; c < classCount; ++c) {
+            auto left = leaving.find(c);
+            newOffsets[c + 1] = count(c) - (left == leaving.end() ? 0 : left->second);
+        }
+        for (const Group &group : groups)
+            newOffsets[group.target + 1] += static_cast<unsigned int>(group.vertices.size());
+        for (unsigned int c = 0; c < nextClass; ++c)
+            newOffsets[c + 1] += newOffsets[c];
+
+        // the remaining members keep their order, the arrivals are appended
+        std::vector<unsigned int> newVertices(newOffsets.back());
+        std::vector<unsigned int> next(newOffsets.begin(), newOffsets.end() - 1);
+        for (unsigned int c = 0; c < classCount; ++c)
+            for (unsigned int m = offsets[c]; m < offsets[c + 1]; ++m)
+                if (classOfVertex[vertices[m]] == c)
+                    newVertices[next[c]++] = vertices[m];
+        for (const Group &group : groups)
+            if (group.target != group.source)
+                for (unsigned int v : group.vertices)
+                    newVertices[next[group.target]++] = v;
+
+        offsets.swap(newOffsets);
+        vertices.swap(newVertices);
+
+        unsigned long emptyClasses = 0;
+        for (unsigned long c = 0; c < size(); ++c)
+            if (count(c) == 0)
+                ++emptyClasses;
+        if (emptyClasses <= size() / 8)
+            return false;
+
+        // empty classes hold no vertices, so dropping their offsets leaves the vertex order as it is
+        std::vector<unsigned int> newId(size(), none);
+        unsigned int kept = 0;
+        for (unsigned long c = 0; c < size(); ++c) {
+            if (count(c) == 0)
+                continue;
+            newId[c] = kept;
+            offsets[kept + 1] = offsets[c + 1];
+            weightOfClass[kept] = weightOfClass[c];
+            ++kept;
+        }
+        offsets.resize(kept + 1);
+        weightOfClass.resize(kept);
+        for (unsigned int &c : classOfVertex)
+            c = newId[c];
+        for (auto &entry : classOfWeight)
+            entry.second = newId[entry.second];
+        for (std::size_t i = firstChanged; i < changedClasses.size(); ++i)
+            changedClasses[i] = newId[changedClasses[i]];
+        return true;
+    }
+}
@@ -0,0 +1,245 @@
+#include <cor/WeightNeighbourIndex.h>
+
+#include <algorithm>
+#include <iterator>
+#include <unordered_map>
+
+namespace CoR {
+    namespace {
+        const unsigned int LeafSize = 8;
+    }
+
+    // vantage-point tree: inner nodes split by the median distance to their vantage point
+    class VantagePointTree {
+        struct Node {
+            unsigned int begin, end;
+            float radius;
+            int inside, outside;
+        };
+
+        const std::vector<WeightsPerBone> _weights;
+        std::vector<unsigned int> _items;
+        std::vector<Node> _nodes;
+
+        struct ItemDistance {
+            float distance;
+            unsigned int item;
+
+            bool operator < (const ItemDistance &other) const {
+                return distance < other.distance;
+            }
+        };
+
+        int build(unsigned int begin, unsigned int end, std::vector<ItemDistance> &scratch) {
+            if (begin == end)
+                return -1;
+
+            int index = static_cast<int>(_nodes.size());
+            _nodes.push_back(Node{begin, end, 0, -1, -1});
+            if (end - begin <= LeafSize)
+                return index;
+
+            std::swap(_items[begin], _items[begin + (end - begin) / 2]);
+            const WeightsPerBone &vantage = _weights[_items[begin]];
+
+            scratch.clear();
+            for (unsigned int i = begin + 1; i < end; ++i)
+                scratch.push_back(ItemDistance{skinningWeightsDistance(vantage, _weights[_items[i]]), _items[i]});
+
+            std::size_t median = scratch.size() / 2;
+            std::nth_element(scratch.begin(), scratch.begin() + median, scratch.end());
+            for (std::size_t i = 0; i < scratch.size(); ++i)
+                _items[begin + 1 + i] = scratch[i].item;
+
+            unsigned int split = begin + 1 + static_cast<unsigned int>(median);
+            float radius = scratch[median].distance;
+            int inside = build(begin + 1, split, scratch);
+            int outside = build(split, end, scratch);
+
+            Node &node = _nodes[index];
+            node.radius = radius;
+            node.inside = inside;
+            node.outside = outside;
+            return index;
+        }
+
+    public:
+        explicit VantagePointTree(const std::vector<WeightsPerBone> &weights) : _weights(weights) {
+            _items.resize(weights.size());
+            for (unsigned int i = 0; i < _items.size(); ++i)
+                _items[i] = i;
+
+            std::vector<ItemDistance> scratch;
+            scratch.reserve(weights.size());
+            build(0, static_cast<unsigned int>(_items.size()), scratch);
+        }
+
+        // appends every item closer than omega; subtrees are pruned with radius prune <= omega
+        void query(const WeightsPerBone &q, float omega, float prune, std::vector<unsigned int> &out, std::vector<int> &stack) const {
+            if (_nodes.empty())
+                return;
+
+            stack.clear();
+            stack.push_back(0);
+            while (!stack.empty()) {
+                const Node &node = _nodes[stack.back()];
+                stack.pop_back();
+
+                if (node.end - node.begin <= LeafSize) {
+                    for (unsigned int i = node.begin; i < node.end; ++i)
+                        if (skinningWeightsDistance(q, _weights[_items[i]]) < omega)
+                            out.push_back(_items[i]);
+                    continue;
+                }
+
+                float d = skinningWeightsDistance(q, _weights[_items[node.begin]]);
+                if (d < omega)
+                    out.push_back(_items[node.begin]);
+
+                if (node.inside >= 0 && d - prune <= node.radius)
+                    stack.push_back(node.inside);
+                if (node.outside >= 0 && d + prune >= node.radius)
+                    stack.push_back(node.outside);
+            }
+        }
+
+        unsigned long size() const {
+            return _weights.size();
+        }
+
+        const WeightsPerBone & weight(unsigned int item) const {
+            return _weights[item];
+        }
+    };
+
+    void WeightNeighbourIndex::build(const std::vector<WeightsPerBone> &classWeights, float omega, float approximation, ThreadPool *pool)
+    {
+        const unsigned long classCount = classWeights.size();
+        const unsigned long blockSize = 256;
+        const unsigned long blockCount = (classCount + blockSize - 1) / blockSize;
+
+        std::shared_ptr<const VantagePointTree> searchTree = std::make_shared<VantagePointTree>(classWeights);
+        float prune = omega / (1.0f + std::max(approximation, 0.0f));
+
+        // every block of classes collects its neighbourhoods on its own, then they are concatenated in order
+        std::vector<std::vector<unsigned int>> blockNeighbours(blockCount);
+        std::vector<std::vector<unsigned int>> blockCounts(blockCount);
+        auto queryBlocks = [&](unsigned long fromBlock, unsigned long toBlock) {
+            std::vector<int> stack;
+            for (unsigned long b = fromBlock; b < toBlock; ++b) {
+                std::vector<unsigned int> &found = blockNeighbours[b];
+                for (unsigned long c = b * blockSize; c < std::min(classCount, (b + 1) * blockSize); ++c) {
+                    std::size_t first = found.size();
+                    searchTree->query(classWeights[c], omega, prune, found, stack);
+                    std::sort(found.begin() + first, found.end());
+                    blockCounts[b].push_back(static_cast<unsigned int>(found.size() - first));
+                }
+            }
+        };
+        if (pool)
+            pool->parallelFor(0, blockCount, 1, queryBlocks);
+        else
+            queryBlocks(0, blockCount);
+
+        offsets.assign(1, 0);
+        offsets.reserve(classCount + 1);
+        neighbours.clear();
+        for (unsigned long b = 0; b < blockCount; ++b) {
+            for (unsigned int count : blockCounts[b])
+                offsets.push_back(offsets.back() + count);
+            neighbours.insert(neighbours.end(), blockNeighbours[b].begin(), blockNeighbours[b].end());
+        }
+
+        tree = searchTree;
+        searchOmega = omega;
+        searchApproximation = approximation;
+        detachedClasses.clear();
+        detachedWeights.clear();
+    }
+
+    void WeightNeighbourIndex::update(const std::vector<unsigned int> &changedClasses, const std::vector<WeightsPerBone> &changedWeights, ThreadPool *pool)
+    {
+        const unsigned long oldCount = size();
+        unsigned long classCount = oldCount;
+        for (unsigned int c : changedClasses)
+            classCount = std::max(classCount, c + 1ul);
+
+        std::unordered_map<unsigned int, unsigned int> detachedSlot;
+        for (unsigned int i = 0; i < detachedClasses.size(); ++i)
+            detachedSlot[detachedClasses[i]] = i;
+        for (std::size_t i = 0; i < changedClasses.size(); ++i) {
+            auto inserted = detachedSlot.insert(std::make_pair(changedClasses[i], static_cast<unsigned int>(detachedClasses.size())));
+            if (inserted.second) {
+                detachedClasses.push_back(changedClasses[i]);
+                detachedWeights.push_back(changedWeights[i]);
+            } else {
+                detachedWeights[inserted.first->second] = changedWeights[i];
+            }
+        }
+
+        if (detachedClasses.size() > std::max<std::size_t>(LeafSize, tree->size() / 8)) {
+            std::vector<WeightsPerBone> classWeights(classCount);
+            for (unsigned int c = 0; c < tree->size(); ++c)
+                classWeights[c] = tree->weight(c);
+            for (std::size_t i = 0; i < detachedClasses.size(); ++i)
+                classWeights[detachedClasses[i]] = detachedWeights[i];
+            build(classWeights, searchOmega, searchApproximation, pool);
+            return;
+        }
+
+        // tree hits with an outdated weight are dropped, the detached classes are compared directly
+        const float prune = searchOmega / (1.0f + std::max(searchApproximation, 0.0f));
+        std::vector<std::vector<unsigned int>> found(changedClasses.size());
+        auto queryClasses = [&](unsigned long from, unsigned long to) {
+            std::vector<int> stack;
+            for (unsigned long i = from; i < to; ++i) {
+                std::vector<unsigned int> &hits = found[i];
+                tree->query(changedWeights[i], searchOmega, prune, hits, stack);
+                hits.erase(std::remove_if(hits.begin(), hits.end(), [&](unsigned int c) {
+                    return detachedSlot.count(c) > 0;
+                }), hits.end());
+                for (std::size_t d = 0; d < detachedClasses.size(); ++d)
+                    if (skinningWeightsDistance(changedWeights[i], detachedWeights[d]) < searchOmega)
+                        hits.push_back(detachedClasses[d]);
+                std::sort(hits.begin(), hits.end());
+            }
+        };
+        if (pool)
+            pool->parallelFor(0, changedClasses.size(), 1, queryClasses);
+        else
+            queryClasses(0, changedClasses.size());
+
+        // the relation is symmetric, so the unchanged neighbours of a changed class gain it
+        std::unordered_map<unsigned int, std::vector<unsigned int>> additions;
+        for (std::size_t i = 0; i < changedClasses.size(); ++i)
+            for (unsigned int c : found[i])
+                if (!std::binary_search(changedClasses.begin(), changedClasses.end(), c))
+                    additions[c].push_back(changedClasses[i]);
+
+        std::vector<unsigned int> newOffsets(1, 0);
+        std::vector<unsigned int> newNeighbours;
+        newOffsets.reserve(classCount + 1);
+        newNeighbours.reserve(neighbours.size());
+        std::size_t next = 0;
+        std::vector<unsigned int> kept;
+        for (unsigned int c = 0; c < classCount; ++c) {
+            if (next < changedClasses.size() && changedClasses[next] == c) {
+                newNeighbours.insert(newNeighbours.end(), found[next].begin(), found[next].end());
+                ++next;
+            } else if (c < oldCount) {
+                kept.clear();
+                for (unsigned int n = offsets[c]; n < offsets[c + 1]; ++n)
+                    if (!std::binary_search(changedClasses.begin(), changedClasses.end(), neighbours[n]))
+                        kept.push_back(neighbours[n]);
+                auto added = additions.find(c);
+                if (added == additions.end())
+                    newNeighbours.insert(newNeighbours.end(), kept.begin(), kept.end());
+                else
+                    std::merge(kept.begin(), kept.end(), added->second.begin(), added->second.end(), std::back_inserter(newNeighbours));
+            }
+            newOffsets.push_back(static_cast<unsigned int>(newNeighbours.size()));
+        }
+        offsets.swap(newOffsets);
+        neighbours.swap(newNeighbours);
+    }
+}
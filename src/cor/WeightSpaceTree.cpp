@@ -0,0 +1,277 @@
+#include <cor/WeightSpaceTree.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace CoR {
+    namespace {
+        float weightOf(const CoRTriangleStore &store, unsigned int entry, unsigned short bone)
+        {
+            for (unsigned int i = store.weightOffsets[entry]; i < store.weightOffsets[entry + 1]; ++i)
+                if (store.weightBones[i] == bone)
+                    return store.weightValues[i];
+            return 0;
+        }
+
+        // weight range of a bone over count entries
+        struct Bound {
+            unsigned short bone;
+            float min, max;
+            unsigned int count;
+        };
+    }
+
+    void WeightSpaceTree::build(const CoRTriangleStore &store, unsigned int leafSize)
+    {
+        const unsigned int entryCount = static_cast<unsigned int>(store.size());
+
+        nodes.clear();
+        boundBones.clear();
+        boundMin.clear();
+        boundMax.clear();
+        entries.resize(entryCount);
+        for (unsigned int t = 0; t < entryCount; ++t)
+            entries[t] = t;
+        if (entryCount == 0)
+            return;
+
+        unsigned int boneCount = 0;
+        for (unsigned short bone : store.weightBones)
+            boneCount = std::max(boneCount, bone + 1u);
+
+        // per bone range of the node being built, touched lists the bones seen
+        std::vector<float> minWeight(boneCount), maxWeight(boneCount);
+        std::vector<unsigned int> influenced(boneCount, 0);
+        std::vector<unsigned short> touched;
+
+        nodes.push_back(Node{0, entryCount, 0, 0, 0, 0, 0, 0, 0});
+        // nodes are appended in breadth first order, so the pending ones are the tail
+        for (std::size_t n = 0; n < nodes.size(); ++n) {
+            Node node = nodes[n];
+
+            touched.clear();
+            double area = 0, momentX = 0, momentY = 0, momentZ = 0;
+            for (unsigned int i = node.first; i < node.first + node.count; ++i) {
+                unsigned int t = entries[i];
+                area += store.area[t];
+                momentX += store.area[t] * store.centerX[t];
+                momentY += store.area[t] * store.centerY[t];
+                momentZ += store.area[t] * store.centerZ[t];
+
+                for (unsigned int w = store.weightOffsets[t]; w < store.weightOffsets[t + 1]; ++w) {
+                    unsigned short bone = store.weightBones[w];
+                    float value = store.weightValues[w];
+                    if (influenced[bone]++ == 0) {
+                        touched.push_back(bone);
+                        minWeight[bone] = maxWeight[bone] = value;
+                    } else {
+                        minWeight[bone] = std::min(minWeight[bone], value);
+                        maxWeight[bone] = std::max(maxWeight[bone], value);
+                    }
+                }
+            }
+
+            node.area = static_cast<float>(area);
+            node.momentX = static_cast<float>(momentX);
+            node.momentY = static_cast<float>(momentY);
+            node.momentZ = static_cast<float>(momentZ);
+
+            std::sort(touched.begin(), touched.end());
+            node.boundsBegin = static_cast<unsigned int>(boundBones.size());
+            unsigned short splitBone = 0;
+            float widest = 0;
+            for (unsigned short bone : touched) {
+                if (influenced[bone] < node.count)
+                    minWeight[bone] = 0;
+                boundBones.push_back(bone);
+                boundMin.push_back(minWeight[bone]);
+                boundMax.push_back(maxWeight[bone]);
+                if (maxWeight[bone] - minWeight[bone] > widest) {
+                    widest = maxWeight[bone] - minWeight[bone];
+                    splitBone = bone;
+                }
+                influenced[bone] = 0;
+            }
+            node.boundsEnd = static_cast<unsigned int>(boundBones.size());
+
+            // entries of equal weight stay together, their bounds are already exact
+            if (node.count > leafSize && widest > 0) {
+                unsigned int half = node.count / 2;
+                auto first = entries.begin() + node.first;
+                std::nth_element(first, first + half, first + node.count, [&](unsigned int a, unsigned int b) {
+                    return weightOf(store, a, splitBone) < weightOf(store, b, splitBone);
+                });
+
+                node.children = static_cast<unsigned int>(nodes.size());
+                nodes.push_back(Node{node.first, half, 0, 0, 0, 0, 0, 0, 0});
+                nodes.push_back(Node{node.first + half, node.count - half, 0, 0, 0, 0, 0, 0, 0});
+            }
+            nodes[n] = node;
+        }
+
+        positions.resize(entryCount);
+        for (unsigned int i = 0; i < entryCount; ++i)
+            positions[entries[i]] = i;
+    }
+
+    void WeightSpaceTree::refit(const CoRTriangleStore &store, const std::vector<unsigned int> &changedEntries)
+    {
+        // nodes on the paths from the root to the changed entries
+        std::vector<unsigned int> dirty;
+        for (unsigned int entry : changedEntries) {
+            unsigned int position = positions[entry];
+            unsigned int n = 0;
+            while (true) {
+                dirty.push_back(n);
+                const Node &node = nodes[n];
+                if (node.leaf())
+                    break;
+                n = position < nodes[node.children + 1].first ? node.children : node.children + 1;
+            }
+        }
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+        // children come after their parent, so going backwards refits them first
+        std::vector<std::vector<Bound>> bounds(dirty.size());
+        std::vector<Bound> scratch;
+        for (std::size_t d = dirty.size(); d-- > 0;) {
+            Node &node = nodes[dirty[d]];
+            scratch.clear();
+            double area = 0, momentX = 0, momentY = 0, momentZ = 0;
+            if (node.leaf()) {
+                for (unsigned int i = node.first; i < node.first + node.count; ++i) {
+                    unsigned int t = entries[i];
+                    area += store.area[t];
+                    momentX += store.area[t] * store.centerX[t];
+                    momentY += store.area[t] * store.centerY[t];
+                    momentZ += store.area[t] * store.centerZ[t];
+                    for (unsigned int w = store.weightOffsets[t]; w < store.weightOffsets[t + 1]; ++w)
+                        scratch.push_back(Bound{store.weightBones[w], store.weightValues[w], store.weightValues[w], 1});
+                }
+            } else {
+                for (unsigned int c = node.children; c <= node.children + 1; ++c) {
+                    const Node &child = nodes[c];
+                    area += child.area;
+                    momentX += child.momentX;
+                    momentY += child.momentY;
+                    momentZ += child.momentZ;
+                    auto refitted = std::lower_bound(dirty.begin(), dirty.end(), c);
+                    if (refitted != dirty.end() && *refitted == c) {
+                        const std::vector<Bound> &childBounds = bounds[refitted - dirty.begin()];
+                        scratch.insert(scratch.end(), childBounds.begin(), childBounds.end());
+                    } else {
+                        for (unsigned int b = child.boundsBegin; b < child.boundsEnd; ++b)
+                            scratch.push_back(Bound{boundBones[b], boundMin[b], boundMax[b], child.count});
+                    }
+                }
+            }
+
+            // merge the ranges per bone; a bone missing from some entries starts at 0
+            std::sort(scratch.begin(), scratch.end(), [](const Bound &a, const Bound &b) {
+                return a.bone < b.bone;
+            });
+            std::vector<Bound> &merged = bounds[d];
+            for (const Bound &bound : scratch) {
+                if (!merged.empty() && merged.back().bone == bound.bone) {
+                    merged.back().min = std::min(merged.back().min, bound.min);
+                    merged.back().max = std::max(merged.back().max, bound.max);
+                    merged.back().count += bound.count;
+                } else {
+                    merged.push_back(bound);
+                }
+            }
+            for (Bound &bound : merged)
+                if (bound.count < node.count)
+                    bound.min = 0;
+
+            node.area = static_cast<float>(area);
+            node.momentX = static_cast<float>(momentX);
+            node.momentY = static_cast<float>(momentY);
+            node.momentZ = static_cast<float>(momentZ);
+        }
+
+        // bounds that kept their length are overwritten, otherwise all bounds are relaid
+        bool sameLengths = true;
+        for (std::size_t d = 0; d < dirty.size() && sameLengths; ++d)
+            sameLengths = bounds[d].size() == nodes[dirty[d]].boundsEnd - nodes[dirty[d]].boundsBegin;
+
+        if (sameLengths) {
+            for (std::size_t d = 0; d < dirty.size(); ++d) {
+                unsigned int b = nodes[dirty[d]].boundsBegin;
+                for (const Bound &bound : bounds[d]) {
+                    boundMin[b] = bound.min;
+                    boundMax[b++] = bound.max;
+                }
+            }
+            return;
+        }
+
+        std::vector<unsigned short> bones;
+        std::vector<float> mins, maxs;
+        bones.reserve(boundBones.size());
+        mins.reserve(boundMin.size());
+        maxs.reserve(boundMax.size());
+        std::size_t d = 0;
+        for (unsigned int n = 0; n < nodes.size(); ++n) {
+            Node &node = nodes[n];
+            unsigned int begin = static_cast<unsigned int>(bones.size());
+            if (d < dirty.size() && dirty[d] == n) {
+                for (const Bound &bound : bounds[d]) {
+                    bones.push_back(bound.bone);
+                    mins.push_back(bound.min);
+                    maxs.push_back(bound.max);
+                }
+                ++d;
+            } else {
+                bones.insert(bones.end(), boundBones.begin() + node.boundsBegin, boundBones.begin() + node.boundsEnd);
+                mins.insert(mins.end(), boundMin.begin() + node.boundsBegin, boundMin.begin() + node.boundsEnd);
+                maxs.insert(maxs.end(), boundMax.begin() + node.boundsBegin, boundMax.begin() + node.boundsEnd);
+            }
+            node.boundsBegin = begin;
+            node.boundsEnd = static_cast<unsigned int>(bones.size());
+        }
+        boundBones.swap(bones);
+        boundMin.swap(mins);
+        boundMax.swap(maxs);
+    }
+
+    void WeightSpaceTree::similarityBounds(const Node &node, const WeightsPerBone &w, float sigma, float &lower, float &upper) const
+    {
+        // weight ranges of the node for the bones of w, empty ranges for bones it lacks
+        float low[WeightsPerBone::Capacity];
+        float high[WeightsPerBone::Capacity];
+        float vertex[WeightsPerBone::Capacity];
+        int shared = 0;
+        for (int i = 0, b = node.boundsBegin; i < w.size() && b < static_cast<int>(node.boundsEnd);) {
+            if (w.bone(i) < boundBones[b]) {
+                ++i;
+            } else if (boundBones[b] < w.bone(i)) {
+                ++b;
+            } else {
+                low[shared] = boundMin[b];
+                high[shared] = boundMax[b++];
+                vertex[shared++] = w.weight(i++);
+            }
+        }
+
+        const float negInvSigmaSquared = -1.0f / (sigma * sigma);
+        lower = 0;
+        upper = 0;
+        for (int j = 0; j < shared; ++j) {
+            for (int k = j + 1; k < shared; ++k) {
+                // d = a_j w_k - a_k w_j is monotonic in a_j and a_k
+                float dLow = low[j] * vertex[k] - high[k] * vertex[j];
+                float dHigh = high[j] * vertex[k] - low[k] * vertex[j];
+                float dMin = dLow > 0 ? dLow : (dHigh < 0 ? -dHigh : 0);
+                float dMax = std::max(std::fabs(dLow), std::fabs(dHigh));
+
+                float product = vertex[j] * vertex[k];
+                lower += low[j] * low[k] * product * std::exp(dMax * dMax * negInvSigmaSquared);
+                upper += high[j] * high[k] * product * std::exp(dMin * dMin * negInvSigmaSquared);
+            }
+        }
+        lower *= 2;
+        upper *= 2;
+    }
+}
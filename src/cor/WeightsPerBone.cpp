@@ -4,38 +4,158 @@
 
 #include <cor/WeightsPerBone.h>
 #include <iostream>
+#include <cstring>
 
 namespace CoR {
+    namespace {
+        // merges the sorted supports of a and b into a + sign * b
+        WeightsPerBone merge(const WeightsPerBone &a, const WeightsPerBone &b, float sign)
+        {
+            unsigned short bones[2 * WeightsPerBone::Capacity];
+            float weights[2 * WeightsPerBone::Capacity];
+            int n = 0;
+
+            int i = 0, j = 0;
+            while (i < a.count || j < b.count) {
+                if (j == b.count || (i < a.count && a.bones[i] < b.bones[j])) {
+                    bones[n] = a.bones[i];
+                    weights[n++] = a.weights[i++];
+                } else if (i == a.count || b.bones[j] < a.bones[i]) {
+                    bones[n] = b.bones[j];
+                    weights[n++] = sign * b.weights[j++];
+                } else {
+                    bones[n] = a.bones[i];
+                    weights[n++] = a.weights[i++] + sign * b.weights[j++];
+                }
+            }
+
+            return WeightsPerBone::fromSorted(bones, weights, n);
+        }
+    }
+
+    WeightsPerBone WeightsPerBone::fromSorted(const unsigned short *bones, const float *weights, int n)
+    {
+        // drop the weakest influences until the rest fits
+        bool keep[2 * Capacity];
+        int kept = 0;
+        for (int i = 0; i < n; ++i) {
+            keep[i] = weights[i] != 0;
+            kept += keep[i];
+        }
+        while (kept > Capacity) {
+            int weakest = -1;
+            for (int i = 0; i < n; ++i)
+                if (keep[i] && (weakest < 0 || std::fabs(weights[i]) < std::fabs(weights[weakest])))
+                    weakest = i;
+            keep[weakest] = false;
+            --kept;
+        }
+
+        WeightsPerBone ret;
+        for (int i = 0; i < n; ++i) {
+            if (!keep[i])
+                continue;
+            ret.bones[ret.count] = bones[i];
+            ret.weights[ret.count++] = weights[i];
+        }
+        return ret;
+    }
+
+    void WeightsPerBone::set(unsigned int bone, float weight)
+    {
+        unsigned short b[Capacity + 1];
+        float w[Capacity + 1];
+        int n = 0;
+        bool inserted = false;
+
+        for (int i = 0; i < count; ++i) {
+            if (!inserted && bones[i] >= bone) {
+                b[n] = static_cast<unsigned short>(bone);
+                w[n++] = weight;
+                inserted = true;
+                if (bones[i] == bone)
+                    continue;
+            }
+            b[n] = bones[i];
+            w[n++] = weights[i];
+        }
+        if (!inserted) {
+            b[n] = static_cast<unsigned short>(bone);
+            w[n++] = weight;
+        }
+
+        *this = fromSorted(b, w, n);
+    }
+
+    std::size_t WeightsPerBone::hash() const
+    {
+        // FNV-1a over the bone ids and weight bits
+        unsigned long long h = 14695981039346656037ull;
+        for (int i = 0; i < count; ++i) {
+            unsigned int weightBits;
+            std::memcpy(&weightBits, &weights[i], sizeof(weightBits));
+            h = (h ^ bones[i]) * 1099511628211ull;
+            h = (h ^ weightBits) * 1099511628211ull;
+        }
+        return static_cast<std::size_t>(h);
+    }
+
+    WeightsPerBone WeightsPerBone::operator + (const WeightsPerBone &other) const
+    {
+        return merge(*this, other, 1.0f);
+    }
+
+    WeightsPerBone WeightsPerBone::operator - (const WeightsPerBone &other) const
+    {
+        return merge(*this, other, -1.0f);
+    }
+
     float skinningWeightsDistance(const WeightsPerBone & wp, const WeightsPerBone & wv)
     {
-        return (wp - wv).norm();
+        float dist = 0;
+        int i = 0, j = 0;
+        while (i < wp.count || j < wv.count) {
+            float d;
+            if (j == wv.count || (i < wp.count && wp.bones[i] < wv.bones[j]))
+                d = wp.weights[i++];
+            else if (i == wp.count || wv.bones[j] < wp.bones[i])
+                d = wv.weights[j++];
+            else
+                d = wp.weights[i++] - wv.weights[j++];
+            dist += d * d;
+        }
+        return std::sqrt(dist);
     }
 
     float similarity(const WeightsPerBone &wp, const WeightsPerBone &wv, float sigma)
     {
-#ifdef COR_ENABLE_PROFILING
-#endif
+        // only bones influencing both weights contribute
+        float p[WeightsPerBone::Capacity];
+        float v[WeightsPerBone::Capacity];
+        int shared = 0;
+        for (int i = 0, j = 0; i < wp.count && j < wv.count;) {
+            if (wp.bones[i] < wv.bones[j]) {
+                ++i;
+            } else if (wv.bones[j] < wp.bones[i]) {
+                ++j;
+            } else {
+                p[shared] = wp.weights[i++];
+                v[shared++] = wv.weights[j++];
+            }
+        }
+
         float sigmaSquared = sigma * sigma;
         float sim = 0;
-        for (int j = 0; j < wp.size(); ++j) {
-            for (int k = 0; k < wv.size(); ++k) {
-                if (j != k) {
-                    if (j >= wp.size() || k >= wp.size() || j >= wv.size() || k >= wv.size()) {
-                        std::cerr << "Out-of-bounds in similarity: "
-                            << "wp.size()=" << wp.size()
-                            << " wv.size()=" << wv.size()
-                            << " j=" << j
-                            << " k=" << k << "\n";
-                        abort();
-                    }
-                    float exponent = wp[j] * wv[k] - wp[k] * wv[j];
-                    exponent *= exponent;
-                    exponent /= sigmaSquared;
-
-                    sim += wp[j] * wp[k] * wv[j] * wv[k] * std::exp(-exponent);
-                }
+        // the summand is symmetric in (j, k), so every pair is evaluated once
+        for (int j = 0; j < shared; ++j) {
+            for (int k = j + 1; k < shared; ++k) {
+                float exponent = p[j] * v[k] - p[k] * v[j];
+                exponent *= exponent;
+                exponent /= sigmaSquared;
+
+                sim += p[j] * p[k] * v[j] * v[k] * std::exp(-exponent);
             }
         }
-        return sim;
+        return 2 * sim;
     }
 }
\ No newline at end of file
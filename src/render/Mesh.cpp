@@ -4,6 +4,7 @@
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <unordered_map>
+#include <cor/CoRQuantization.h>
 
 void Mesh::initBuffers() {
     // Generate & bind a VAO
@@ -58,16 +59,34 @@ void Mesh::initBuffers() {
         //std::cout << "[DEBUG] attrib 2 enabled = " << enabled << "\n";
     }
 
-    // CoRs @ layout(6)
+    // CoRs @ layout(6), floats or normalized unsigned shorts (half the bandwidth)
     glGenBuffers(1, &vboCoR);
     glBindBuffer(GL_ARRAY_BUFFER, vboCoR);
-    glBufferData(GL_ARRAY_BUFFER,
-        centersOfRotation.size() * sizeof(glm::vec3),
-        centersOfRotation.data(),
-        GL_STATIC_DRAW);
     glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE,
-        sizeof(glm::vec3), (void*)0);
+    const glm::vec3* cors = corSource.data ? corSource.data : centersOfRotation.data();
+    size_t corCount = corSource.data ? corSource.size : centersOfRotation.size();
+    if (quantizeCoRs) {
+        CoR::QuantizedCoRs quantized = CoR::QuantizedCoRs::quantize(cors, corCount);
+        corOrigin = quantized.origin;
+        corExtent = quantized.extent;
+        // tightly packed, 6 bytes a cor; GL accepts strides that are not a multiple of 4
+        glBufferData(GL_ARRAY_BUFFER,
+            quantized.values.size() * sizeof(GLushort),
+            quantized.values.data(),
+            GL_STATIC_DRAW);
+        glVertexAttribPointer(6, 3, GL_UNSIGNED_SHORT, GL_TRUE,
+            3 * sizeof(GLushort), (void*)0);
+    }
+    else {
+        corOrigin = glm::vec3(0.0f);
+        corExtent = glm::vec3(1.0f);
+        glBufferData(GL_ARRAY_BUFFER,
+            corCount * sizeof(glm::vec3),
+            cors,
+            GL_STATIC_DRAW);
+        glVertexAttribPointer(6, 3, GL_FLOAT, GL_FALSE,
+            sizeof(glm::vec3), (void*)0);
+    }
 
     // Pack skinInfo into a temporary VBO
     struct SkinPack {
@@ -176,6 +195,12 @@ void Mesh::uploadSkeletonUniforms(GLuint skinProg, const std::vector<glm::mat4>&
     }
 }
 
+void Mesh::uploadCoRUniforms(GLuint skinProg) const
+{
+    glUniform3fv(glGetUniformLocation(skinProg, "uCoROrigin"), 1, glm::value_ptr(corOrigin));
+    glUniform3fv(glGetUniformLocation(skinProg, "uCoRExtent"), 1, glm::value_ptr(corExtent));
+}
+
 void Mesh::flattenVertices()
 {
     std::vector<glm::vec3> newPos;
@@ -211,7 +236,7 @@ void Mesh::flattenVertices()
             newPos.push_back(positions[key.posIdx]);
             newNorm.push_back(normals[key.normIdx]);
             newUV.push_back(uvs[key.uvIdx]);
-            newCoR.push_back(centersOfRotation[key.posIdx]);
+            newCoR.push_back(corSource.data ? corSource[key.posIdx] : centersOfRotation[key.posIdx]);
             newSkin.push_back(skinInfo[key.posIdx]);
 
             newIdx.push_back(newIndex);
@@ -228,6 +253,8 @@ void Mesh::flattenVertices()
     indices.swap(newIdx);
     centersOfRotation.swap(newCoR);
     skinInfo.swap(newSkin);
+    // the file's cors are per original vertex
+    corSource = CoR::CoRSpan();
 }
 
 DualQuaternion makeDualQuat(const glm::mat4& M)
@@ -153,6 +153,7 @@ void Render::run() {
 
         // Upload skeleton data
         mesh_.uploadSkeletonUniforms(shader_.GetProgID(), boneMats, dqs);
+        mesh_.uploadCoRUniforms(shader_.GetProgID());
 
         // Draw
         mesh_.draw();
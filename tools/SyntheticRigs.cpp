@@ -0,0 +1,210 @@
+#include "SyntheticRigs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+
+namespace CoRTools {
+    namespace {
+        const float Pi = 3.14159265358979f;
+        // vertices around every tube
+        const unsigned int Segments = 24;
+
+        /**
+         * A tube from `from` to `to` skinned to a chain of bones covering equal parts
+         * of its length. Neighbouring chain bones blend linearly over blend (a
+         * fraction of one bone) around their joint, the first bone blends into the
+         * root bones the same way.
+         */
+        struct Limb {
+            glm::vec3 from, to;
+            float radius;
+            std::vector<unsigned int> chain;
+            std::vector<unsigned int> roots;
+            float blend;
+        };
+
+        typedef std::vector<std::pair<unsigned int, float>> Influences;
+
+        Influences limbWeights(const Limb &limb, float t)
+        {
+            const unsigned int bones = static_cast<unsigned int>(limb.chain.size());
+            float position = t * bones;
+            unsigned int i = std::min(static_cast<unsigned int>(position), bones - 1);
+            float local = position - i;
+            float b = std::min(limb.blend, 0.5f);
+
+            Influences influences;
+            if (i + 1 < bones && local > 1 - b) {
+                float s = (local - (1 - b)) / (2 * b);
+                influences.push_back(std::make_pair(limb.chain[i], 1 - s));
+                influences.push_back(std::make_pair(limb.chain[i + 1], s));
+            } else if (local < b && (i > 0 || !limb.roots.empty())) {
+                float s = (b - local) / (2 * b);
+                influences.push_back(std::make_pair(limb.chain[i], 1 - s));
+                if (i > 0) {
+                    influences.push_back(std::make_pair(limb.chain[i - 1], s));
+                } else {
+                    for (unsigned int root : limb.roots)
+                        influences.push_back(std::make_pair(root, s / limb.roots.size()));
+                }
+            } else {
+                influences.push_back(std::make_pair(limb.chain[i], 1.0f));
+            }
+            return influences;
+        }
+
+        void appendLimb(SyntheticRig &rig, const Limb &limb, unsigned long vertexCount)
+        {
+            const unsigned int rings = std::max(2u, static_cast<unsigned int>(vertexCount / Segments));
+            const unsigned int first = static_cast<unsigned int>(rig.vertices.size());
+
+            glm::vec3 axis = limb.to - limb.from;
+            glm::vec3 direction = axis / glm::length(axis);
+            glm::vec3 helper = std::fabs(direction.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+            glm::vec3 normal = glm::cross(direction, helper);
+            normal = normal / glm::length(normal);
+            glm::vec3 binormal = glm::cross(direction, normal);
+
+            for (unsigned int r = 0; r < rings; ++r) {
+                float t = float(r) / (rings - 1);
+                for (unsigned int s = 0; s < Segments; ++s) {
+                    float angle = 2 * Pi * s / Segments;
+                    // slightly oblique joints, so weights vary around the tube like painted ones
+                    float skew = 0.25f * limb.blend * std::sin(3 * angle) / limb.chain.size();
+                    Influences influences = limbWeights(limb, std::min(1.0f, std::max(0.0f, t + skew)));
+                    rig.vertices.push_back(limb.from + axis * t + (normal * std::cos(angle) + binormal * std::sin(angle)) * limb.radius);
+
+                    rig.boneIndices.push_back(std::vector<unsigned int>());
+                    rig.boneWeights.push_back(std::vector<float>());
+                    for (const auto &influence : influences) {
+                        rig.boneIndices.back().push_back(influence.first);
+                        rig.boneWeights.back().push_back(influence.second);
+                    }
+                }
+            }
+
+            for (unsigned int r = 0; r + 1 < rings; ++r) {
+                for (unsigned int s = 0; s < Segments; ++s) {
+                    unsigned int a = first + r * Segments + s;
+                    unsigned int b = first + r * Segments + (s + 1) % Segments;
+                    unsigned int c = a + Segments;
+                    unsigned int d = b + Segments;
+                    unsigned int quad[6] = {a, c, b, b, c, d};
+                    rig.indices.insert(rig.indices.end(), quad, quad + 6);
+                }
+            }
+        }
+
+        // splits vertexCount over the limbs by their surface area
+        SyntheticRig buildRig(const std::string &name, unsigned int boneCount, const std::vector<Limb> &limbs, unsigned long vertexCount)
+        {
+            float totalArea = 0;
+            for (const Limb &limb : limbs)
+                totalArea += glm::length(limb.to - limb.from) * limb.radius;
+
+            SyntheticRig rig;
+            rig.name = name;
+            rig.boneCount = boneCount;
+            for (const Limb &limb : limbs)
+                appendLimb(rig, limb, static_cast<unsigned long>(vertexCount * glm::length(limb.to - limb.from) * limb.radius / totalArea));
+            return rig;
+        }
+    }
+
+    SyntheticRig makeCylinderChain(unsigned long vertexCount, unsigned int bones)
+    {
+        Limb tube;
+        tube.from = glm::vec3(0, 0, 0);
+        tube.to = glm::vec3(0, 2.0f * bones, 0);
+        tube.radius = 1;
+        tube.blend = 0.3f;
+        for (unsigned int b = 0; b < bones; ++b)
+            tube.chain.push_back(b);
+        return buildRig("cylinder", bones, std::vector<Limb>(1, tube), vertexCount);
+    }
+
+    SyntheticRig makeHandRig(unsigned long vertexCount, unsigned int fingers)
+    {
+        // bone 0 is the palm, finger f owns bones 1 + 3f .. 3 + 3f
+        std::vector<Limb> limbs;
+
+        Limb palm;
+        palm.from = glm::vec3(0, 0, 0);
+        palm.to = glm::vec3(0, 4, 0);
+        palm.radius = 1.5f;
+        palm.chain.push_back(0);
+        palm.blend = 0;
+        limbs.push_back(palm);
+
+        for (unsigned int f = 0; f < fingers; ++f) {
+            float spread = fingers > 1 ? float(f) / (fingers - 1) - 0.5f : 0;
+            bool thumb = f == 0 && fingers > 1;
+
+            Limb finger;
+            finger.from = thumb ? glm::vec3(-1.4f, 1.5f, 0) : glm::vec3(2.4f * spread, 4, 0);
+            glm::vec3 direction = thumb ? glm::vec3(-0.8f, 0.6f, 0.3f) : glm::vec3(0.4f * spread, 1, 0);
+            finger.to = finger.from + direction / glm::length(direction) * (thumb ? 3.0f : 4.5f);
+            finger.radius = 0.35f;
+            for (unsigned int b = 0; b < 3; ++b)
+                finger.chain.push_back(1 + 3 * f + b);
+            finger.roots.push_back(0);
+            finger.blend = 0.35f;
+            limbs.push_back(finger);
+        }
+        return buildRig("hand", 1 + 3 * fingers, limbs, vertexCount);
+    }
+
+    SyntheticRig makeHumanoidRig(unsigned long vertexCount)
+    {
+        enum Bone {
+            Pelvis, SpineLower, SpineUpper, Chest, Neck, Head,
+            LeftClavicle, LeftUpperArm, LeftForearm, LeftHand,
+            RightClavicle, RightUpperArm, RightForearm, RightHand,
+            LeftThigh, LeftShin, LeftFoot,
+            RightThigh, RightShin, RightFoot,
+            BoneCount
+        };
+
+        auto limb = [](glm::vec3 from, glm::vec3 to, float radius, std::vector<unsigned int> chain, std::vector<unsigned int> roots) {
+            Limb l;
+            l.from = from;
+            l.to = to;
+            l.radius = radius;
+            l.chain = chain;
+            l.roots = roots;
+            l.blend = 0.25f;
+            return l;
+        };
+
+        std::vector<Limb> limbs;
+        limbs.push_back(limb(glm::vec3(0, 9, 0), glm::vec3(0, 15, 0), 1.6f, {Pelvis, SpineLower, SpineUpper, Chest}, {}));
+        limbs.push_back(limb(glm::vec3(0, 15, 0), glm::vec3(0, 18, 0), 0.9f, {Neck, Head}, {Chest}));
+        // shoulders blend into chest and neck, hips into pelvis and the lower spine
+        limbs.push_back(limb(glm::vec3(-0.8f, 14.5f, 0), glm::vec3(-8, 14.5f, 0), 0.55f, {LeftClavicle, LeftUpperArm, LeftForearm, LeftHand}, {Chest, Neck}));
+        limbs.push_back(limb(glm::vec3(0.8f, 14.5f, 0), glm::vec3(8, 14.5f, 0), 0.55f, {RightClavicle, RightUpperArm, RightForearm, RightHand}, {Chest, Neck}));
+        limbs.push_back(limb(glm::vec3(-0.9f, 9.2f, 0), glm::vec3(-1.1f, 0, 0), 0.8f, {LeftThigh, LeftShin, LeftFoot}, {Pelvis, SpineLower}));
+        limbs.push_back(limb(glm::vec3(0.9f, 9.2f, 0), glm::vec3(1.1f, 0, 0), 0.8f, {RightThigh, RightShin, RightFoot}, {Pelvis, SpineLower}));
+        return buildRig("humanoid", BoneCount, limbs, vertexCount);
+    }
+
+    const std::vector<std::string> & rigKinds()
+    {
+        static const std::vector<std::string> kinds = {"cylinder", "hand", "humanoid"};
+        return kinds;
+    }
+
+    SyntheticRig makeSyntheticRig(const std::string &kind, unsigned long vertexCount)
+    {
+        if (kind == "cylinder")
+            return makeCylinderChain(vertexCount);
+        if (kind == "hand")
+            return makeHandRig(vertexCount);
+        if (kind == "humanoid")
+            return makeHumanoidRig(vertexCount);
+
+        std::cerr << "Error: Unknown synthetic rig \"" << kind << "\", expected cylinder, hand or humanoid." << std::endl;
+        exit(1);
+    }
+}
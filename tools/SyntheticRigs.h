@@ -0,0 +1,37 @@
+/*****************************************************************************
+Parametric skinned test meshes for the CoR tools, so benchmarks and accuracy
+checks do not depend on proprietary assets.
+*****************************************************************************/
+
+#ifndef CORTOOLS_SYNTHETICRIGS_H
+#define CORTOOLS_SYNTHETICRIGS_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace CoRTools {
+    // a triangle mesh with per vertex bone indices and weights, as FBXLoader provides them
+    struct SyntheticRig {
+        std::string name;
+        unsigned int boneCount = 0;
+        std::vector<glm::vec3> vertices;
+        std::vector<unsigned int> indices;
+        std::vector<std::vector<unsigned int>> boneIndices;
+        std::vector<std::vector<float>> boneWeights;
+    };
+
+    // a tube along a chain of bones, blended linearly across every joint
+    SyntheticRig makeCylinderChain(unsigned long vertexCount, unsigned int bones = 8);
+    // a palm with fingers of three bones branching from it, finger roots blend into the palm
+    SyntheticRig makeHandRig(unsigned long vertexCount, unsigned int fingers = 5);
+    // spine, neck and head, arms and legs with three influences around shoulders and hips
+    SyntheticRig makeHumanoidRig(unsigned long vertexCount);
+
+    // "cylinder", "hand" or "humanoid" with about vertexCount vertices; kind must be one of rigKinds()
+    SyntheticRig makeSyntheticRig(const std::string &kind, unsigned long vertexCount);
+    const std::vector<std::string> & rigKinds();
+}
+
+#endif //CORTOOLS_SYNTHETICRIGS_H
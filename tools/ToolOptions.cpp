@@ -0,0 +1,112 @@
+#include "ToolOptions.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+namespace CoRTools {
+    std::vector<std::string> splitList(const std::string &list)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ','))
+            if (!item.empty())
+                items.push_back(item);
+        return items;
+    }
+
+    std::vector<unsigned long> splitNumbers(const std::string &list)
+    {
+        std::vector<unsigned long> numbers;
+        for (const std::string &item : splitList(list))
+            numbers.push_back(std::stoul(item));
+        return numbers;
+    }
+
+    bool parseOptions(int argc, char **argv,
+                      const std::function<bool(const std::string &option, const std::string &value)> &handle,
+                      std::vector<std::string> *positional)
+    {
+        for (int i = 1; i < argc; ++i) {
+            std::string option = argv[i];
+            if (positional && option.compare(0, 2, "--") != 0) {
+                positional->push_back(option);
+                continue;
+            }
+            if (i + 1 >= argc) {
+                std::cerr << "Error: Missing value for " << option << std::endl;
+                return false;
+            }
+            if (!handle(option, argv[++i])) {
+                std::cerr << "Error: Unknown option " << option << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::unique_ptr<CoR::CoRCalculator> makeCalculator(const std::string &name, float sigma, float omega, bool subdivide,
+                                                       const std::shared_ptr<CoR::ThreadPool> &pool)
+    {
+        if (name == "bruteforce")
+            return std::unique_ptr<CoR::CoRCalculator>(new CoR::CoRCalculator(pool, sigma, omega, subdivide));
+        if (name == "aggregated")
+            return std::unique_ptr<CoR::CoRCalculator>(new CoR::CoRCalculator(pool, sigma, omega, subdivide, true));
+        if (name == "pruned") {
+            std::unique_ptr<CoR::CoRCalculator> calculator(new CoR::CoRCalculator(pool, sigma, omega, subdivide));
+            calculator->setSimilarityCutoff(1e-4f);
+            return calculator;
+        }
+        if (name == "bfs")
+            return std::unique_ptr<CoR::CoRCalculator>(new CoR::BFSCoRCalculator(pool, sigma, omega, subdivide));
+        if (name == "hierarchical")
+            return std::unique_ptr<CoR::CoRCalculator>(new CoR::HierarchicalCoRCalculator(pool, sigma, omega, subdivide));
+
+        std::cerr << "Error: Unknown calculator " << jsonString(name)
+                  << ", expected bruteforce, aggregated, pruned, bfs or hierarchical." << std::endl;
+        exit(1);
+    }
+
+    std::unique_ptr<CoR::CoRCalculator> makeCalculator(const std::string &name, float sigma, float omega, bool subdivide,
+                                                       unsigned int threads)
+    {
+        return makeCalculator(name, sigma, omega, subdivide,
+                              threads == 0 ? CoR::ThreadPool::shared() : std::make_shared<CoR::ThreadPool>(threads));
+    }
+
+    std::string jsonString(const std::string &text)
+    {
+        std::string quoted = "\"";
+        for (char c : text) {
+            switch (c) {
+                case '"':
+                    quoted += "\\\"";
+                    break;
+                case '\\':
+                    quoted += "\\\\";
+                    break;
+                case '\n':
+                    quoted += "\\n";
+                    break;
+                case '\r':
+                    quoted += "\\r";
+                    break;
+                case '\t':
+                    quoted += "\\t";
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escaped[7];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(static_cast<unsigned char>(c)));
+                        quoted += escaped;
+                    } else {
+                        // UTF-8 passes through unchanged
+                        quoted += c;
+                    }
+            }
+        }
+        return quoted + "\"";
+    }
+}
@@ -0,0 +1,45 @@
+/*****************************************************************************
+Command line parsing, calculator selection and JSON output shared by the CoR
+tools.
+*****************************************************************************/
+
+#ifndef CORTOOLS_TOOLOPTIONS_H
+#define CORTOOLS_TOOLOPTIONS_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cor/CoRCalculator.h>
+
+namespace CoRTools {
+    // the comma separated items of list, empty items are dropped
+    std::vector<std::string> splitList(const std::string &list);
+    std::vector<unsigned long> splitNumbers(const std::string &list);
+
+    /**
+     * Calls handle for every "--option value" pair of the command line, handle
+     * returns false for an option it does not know. Arguments without "--" are
+     * collected in positional, or rejected if it is null. Prints the problem
+     * and returns false for an unknown option or a missing value.
+     */
+    bool parseOptions(int argc, char **argv,
+                      const std::function<bool(const std::string &option, const std::string &value)> &handle,
+                      std::vector<std::string> *positional = nullptr);
+
+    /**
+     * "bruteforce", "aggregated", "pruned", "bfs" or "hierarchical" running on
+     * pool (null: the shared pool); prints the problem and exits for any other name.
+     */
+    std::unique_ptr<CoR::CoRCalculator> makeCalculator(const std::string &name, float sigma, float omega, bool subdivide,
+                                                       const std::shared_ptr<CoR::ThreadPool> &pool);
+    // the same with a private pool of threads workers, 0 shares the shared pool
+    std::unique_ptr<CoR::CoRCalculator> makeCalculator(const std::string &name, float sigma, float omega, bool subdivide,
+                                                       unsigned int threads);
+
+    // text as a quoted JSON string, escaping quotes, backslashes and control characters
+    std::string jsonString(const std::string &text);
+}
+
+#endif //CORTOOLS_TOOLOPTIONS_H
@@ -0,0 +1,362 @@
+/*****************************************************************************
+Checks the optimized CoR calculators against the brute force reference.
+
+Usage: cor_accuracy [--rigs cylinder,hand,humanoid] [--sizes 5000]
+                    [--meshes a.fbx,b.fbx] [--references a.cors,b.cors]
+                    [--variants aggregated,pruned,bfs,hierarchical]
+                    [--sigma 0.1] [--omega 0.1] [--subdivide 0|1] [--threads 4]
+                    [--max-error 0.01] [--mean-error 0.001] [--p99-error 0.005]
+                    [--min-speedup 0] [--update-rounds 3] [--update-error 0.005]
+                    [--output report.json]
+
+Every synthetic rig and recorded FBX mesh is baked once with the reference
+CoRCalculator and once with every variant. The displacement of each cor from
+its reference is divided by the diagonal of the mesh bounding box; a variant
+fails if the max, mean or 99th percentile of it exceeds its threshold, or if
+it is slower than --min-speedup times the reference. --references pairs each
+mesh with a .cors file baked earlier, which then replaces the reference bake
+and its timing. Every variant then edits the weights of a patch of vertices
+--update-rounds times, keeping its cors current with updateCoRs, and fails if
+they move further than --update-error from a fresh bake of the edited mesh;
+the hierarchical variant's refitted tree may approximate a little differently
+than a fresh one.
+Edits alternate between copying weights of other vertices and new weights, and
+the last one restores the original weights. Prints a JSON report and exits
+with 1 if any variant failed.
+*****************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cor/Clock.h>
+#include <cor/CoRCalculator.h>
+
+#include "FBXLoader.h"
+#include "SyntheticRigs.h"
+#include "ToolOptions.h"
+
+namespace {
+    struct Thresholds {
+        float maxError = 0.01f;
+        float meanError = 0.001f;
+        float p99Error = 0.005f;
+        float minSpeedup = 0;
+        float updateError = 0.005f;
+    };
+
+    struct Bake {
+        std::vector<glm::vec3> cors;
+        // createCoRMesh and calculateCoRsAsync, 0 for a recorded reference
+        double seconds = 0;
+    };
+
+    struct Displacement {
+        float max = 0;
+        float mean = 0;
+        float p50 = 0;
+        float p90 = 0;
+        float p99 = 0;
+    };
+
+    std::vector<glm::vec3> calculate(CoR::CoRCalculator &calculator, const CoR::CoRMesh &mesh)
+    {
+        std::vector<glm::vec3> result;
+        std::shared_ptr<CoR::CoRJob> job = calculator.calculateCoRsAsync(mesh, [&result](std::vector<glm::vec3> &cors) {
+            result.swap(cors);
+        });
+        job->wait();
+        return result;
+    }
+
+    CoR::CoRMesh createMesh(CoR::CoRCalculator &calculator, const CoRTools::SyntheticRig &rig)
+    {
+        std::vector<CoR::WeightsPerBone> weights = calculator.convertWeights(rig.boneCount, rig.boneIndices, rig.boneWeights);
+        return calculator.createCoRMesh(
+                std::vector<glm::vec3>(rig.vertices), std::vector<unsigned int>(rig.indices), std::move(weights));
+    }
+
+    Bake bake(CoR::CoRCalculator &calculator, const CoRTools::SyntheticRig &rig)
+    {
+        Bake result;
+        CoR::Clock clock;
+        clock.clockStart();
+        CoR::CoRMesh mesh = createMesh(calculator, rig);
+        result.cors = calculate(calculator, mesh);
+        result.seconds = clock.elapsedSeconds();
+        return result;
+    }
+
+    float boundingBoxDiagonal(const std::vector<glm::vec3> &vertices)
+    {
+        if (vertices.empty())
+            return 0;
+        glm::vec3 lower = vertices.front(), upper = vertices.front();
+        for (const glm::vec3 &vertex : vertices) {
+            lower = glm::min(lower, vertex);
+            upper = glm::max(upper, vertex);
+        }
+        return glm::length(upper - lower);
+    }
+
+    float percentile(const std::vector<float> &sorted, float fraction)
+    {
+        size_t index = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+        return sorted[std::min(sorted.size(), std::max<size_t>(index, 1)) - 1];
+    }
+
+    // cors beyond the original vertices (subdivision midpoints) are compared as well
+    Displacement measure(const std::vector<glm::vec3> &reference, const std::vector<glm::vec3> &cors, float diagonal)
+    {
+        Displacement result;
+        if (reference.empty())
+            return result;
+
+        std::vector<float> errors(reference.size());
+        double sum = 0;
+        for (size_t i = 0; i < reference.size(); ++i) {
+            errors[i] = glm::length(cors[i] - reference[i]) / diagonal;
+            sum += errors[i];
+        }
+        std::sort(errors.begin(), errors.end());
+        result.max = errors.back();
+        result.mean = static_cast<float>(sum / errors.size());
+        result.p50 = percentile(errors, 0.5f);
+        result.p90 = percentile(errors, 0.9f);
+        result.p99 = percentile(errors, 0.99f);
+        return result;
+    }
+
+    /**
+     * Largest displacement, relative to diagonal, between the cors updateCoRs kept
+     * current over rounds weight edits and a fresh bake of the edited mesh. The
+     * fresh bake starts from the mesh of the first one, so subdivision is not redone.
+     */
+    float updateError(const std::string &variant, float sigma, float omega, bool subdivide, unsigned int threads,
+                      const CoRTools::SyntheticRig &rig, unsigned int rounds, float diagonal)
+    {
+        std::unique_ptr<CoR::CoRCalculator> calculator = CoRTools::makeCalculator(variant, sigma, omega, subdivide, threads);
+        std::unique_ptr<CoR::CoRCalculator> fresh = CoRTools::makeCalculator(variant, sigma, omega, false, threads);
+        CoR::CoRMesh mesh = createMesh(*calculator, rig);
+        std::vector<glm::vec3> cors = calculate(*calculator, mesh);
+        std::vector<unsigned int> indices;
+        indices.reserve(3 * mesh.triangles.size());
+        for (const CoR::CoRTriangle &t : mesh.triangles) {
+            indices.push_back(static_cast<unsigned int>(t.alpha));
+            indices.push_back(static_cast<unsigned int>(t.beta));
+            indices.push_back(static_cast<unsigned int>(t.gamma));
+        }
+
+        // patches of about a hundredth of the original vertices, which are numbered along the surface
+        const unsigned long vertexCount = rig.vertices.size();
+        const unsigned long patchSize = std::max(1ul, vertexCount / 100);
+        std::mt19937 random(12345);
+        std::vector<unsigned int> edited;
+        std::vector<CoR::WeightsPerBone> original;
+        float error = 0;
+        for (unsigned int round = 0; round < rounds && vertexCount > 0; ++round) {
+            std::vector<unsigned int> changed;
+            std::vector<CoR::WeightsPerBone> weights;
+            if (round + 1 == rounds && round > 0) {
+                changed = edited;
+                weights = original;
+            } else {
+                unsigned long first = random() % vertexCount;
+                unsigned long donor = random() % vertexCount;
+                for (unsigned long v = first; v < std::min(vertexCount, first + patchSize); ++v) {
+                    changed.push_back(static_cast<unsigned int>(v));
+                    if (std::find(edited.begin(), edited.end(), v) == edited.end()) {
+                        edited.push_back(static_cast<unsigned int>(v));
+                        original.push_back(mesh.weights[v]);
+                    }
+                    CoR::WeightsPerBone weight = mesh.weights[round % 2 == 0 ? donor : v];
+                    if (round % 2 == 1 && weight.size() > 0)
+                        weight.set(weight.bone(0), weight.weight(0) * 0.7f);
+                    weights.push_back(weight);
+                }
+            }
+            calculator->updateCoRs(mesh, changed, weights, cors);
+
+            CoR::CoRMesh edit = fresh->createCoRMesh(
+                    std::vector<glm::vec3>(mesh.vertices), std::vector<unsigned int>(indices), std::vector<CoR::WeightsPerBone>(mesh.weights));
+            error = std::max(error, measure(calculate(*fresh, edit), cors, diagonal).max);
+        }
+        return error;
+    }
+
+    CoRTools::SyntheticRig loadRecordedMesh(const std::string &path)
+    {
+        FBXLoader loader;
+        if (!loader.LoadScene(path.c_str())) {
+            std::cerr << "Error: Cannot load FBX " << path << std::endl;
+            exit(1);
+        }
+        const FBXLoader::FBXMeshData &data = loader.GetMeshData();
+
+        CoRTools::SyntheticRig rig;
+        rig.name = path;
+        rig.boneCount = loader.GetSkeletonData().numberOfBones;
+        rig.vertices = data.vertices;
+        rig.indices = data.faces;
+        rig.boneIndices = data.boneIndices;
+        rig.boneWeights = data.boneWeights;
+        return rig;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> rigs = CoRTools::rigKinds();
+    std::vector<unsigned long> sizes = {5000};
+    std::vector<std::string> meshPaths, referencePaths;
+    std::vector<std::string> variants = {"aggregated", "pruned", "bfs", "hierarchical"};
+    float sigma = 0.1f, omega = 0.1f;
+    bool subdivide = false;
+    unsigned int threads = 4;
+    unsigned int updateRounds = 3;
+    Thresholds thresholds;
+    std::string outputPath;
+
+    bool parsed = CoRTools::parseOptions(argc, argv, [&](const std::string &option, const std::string &value) {
+        if (option == "--rigs")
+            rigs = CoRTools::splitList(value);
+        else if (option == "--sizes")
+            sizes = CoRTools::splitNumbers(value);
+        else if (option == "--meshes")
+            meshPaths = CoRTools::splitList(value);
+        else if (option == "--references")
+            referencePaths = CoRTools::splitList(value);
+        else if (option == "--variants")
+            variants = CoRTools::splitList(value);
+        else if (option == "--sigma")
+            sigma = std::stof(value);
+        else if (option == "--omega")
+            omega = std::stof(value);
+        else if (option == "--subdivide")
+            subdivide = value != "0";
+        else if (option == "--threads")
+            threads = static_cast<unsigned int>(std::stoul(value));
+        else if (option == "--max-error")
+            thresholds.maxError = std::stof(value);
+        else if (option == "--mean-error")
+            thresholds.meanError = std::stof(value);
+        else if (option == "--p99-error")
+            thresholds.p99Error = std::stof(value);
+        else if (option == "--min-speedup")
+            thresholds.minSpeedup = std::stof(value);
+        else if (option == "--update-rounds")
+            updateRounds = static_cast<unsigned int>(std::stoul(value));
+        else if (option == "--update-error")
+            thresholds.updateError = std::stof(value);
+        else if (option == "--output")
+            outputPath = value;
+        else
+            return false;
+        return true;
+    });
+    if (!parsed)
+        return 2;
+    if (!referencePaths.empty() && referencePaths.size() != meshPaths.size()) {
+        std::cerr << "Error: --references needs one .cors file per mesh of --meshes" << std::endl;
+        return 2;
+    }
+
+    // synthetic rigs first, then the recorded meshes with their optional references
+    std::vector<CoRTools::SyntheticRig> meshes;
+    for (const std::string &kind : rigs)
+        for (unsigned long size : sizes)
+            meshes.push_back(CoRTools::makeSyntheticRig(kind, size));
+    size_t firstRecorded = meshes.size();
+    for (const std::string &path : meshPaths)
+        meshes.push_back(loadRecordedMesh(path));
+
+    std::ostringstream json;
+    json << "{\"sigma\": " << sigma << ", \"omega\": " << omega << ", \"subdivide\": " << (subdivide ? "true" : "false")
+         << ", \"threads\": " << threads
+         << ", \"thresholds\": {\"maxError\": " << thresholds.maxError << ", \"meanError\": " << thresholds.meanError
+         << ", \"p99Error\": " << thresholds.p99Error << ", \"minSpeedup\": " << thresholds.minSpeedup
+         << ", \"updateError\": " << thresholds.updateError << "}"
+         << ", \"updateRounds\": " << updateRounds
+         << ", \"runs\": [";
+    bool firstRun = true;
+    unsigned int failures = 0;
+
+    for (size_t m = 0; m < meshes.size(); ++m) {
+        const CoRTools::SyntheticRig &rig = meshes[m];
+        float diagonal = boundingBoxDiagonal(rig.vertices);
+        if (diagonal <= 0) {
+            std::cerr << "Error: " << rig.name << " has an empty bounding box" << std::endl;
+            return 1;
+        }
+
+        Bake reference;
+        if (m >= firstRecorded && !referencePaths.empty()) {
+            reference.cors = CoR::CoRCalculator::loadCoRsFromBinaryFile(referencePaths[m - firstRecorded], true);
+        } else {
+            std::cerr << rig.name << " " << rig.vertices.size() << " vertices, reference" << std::endl;
+            reference = bake(*CoRTools::makeCalculator("bruteforce", sigma, omega, subdivide, threads), rig);
+        }
+
+        for (const std::string &variant : variants) {
+            std::cerr << rig.name << " " << rig.vertices.size() << " vertices, " << variant << std::endl;
+            Bake result = bake(*CoRTools::makeCalculator(variant, sigma, omega, subdivide, threads), rig);
+            if (result.cors.size() != reference.cors.size()) {
+                std::cerr << "Error: " << variant << " baked " << result.cors.size() << " cors of " << rig.name
+                          << ", the reference has " << reference.cors.size() << std::endl;
+                return 1;
+            }
+
+            Displacement displacement = measure(reference.cors, result.cors, diagonal);
+            float speedup = reference.seconds > 0 && result.seconds > 0 ? static_cast<float>(reference.seconds / result.seconds) : 0;
+            float updateDisplacement = updateRounds > 0
+                                       ? updateError(variant, sigma, omega, subdivide, threads, rig, updateRounds, diagonal) : 0;
+            bool passed = displacement.max <= thresholds.maxError
+                          && displacement.mean <= thresholds.meanError
+                          && displacement.p99 <= thresholds.p99Error
+                          && (reference.seconds <= 0 || speedup >= thresholds.minSpeedup)
+                          && updateDisplacement <= thresholds.updateError;
+            if (!passed) {
+                std::cerr << "FAIL " << rig.name << " " << variant << ": max " << displacement.max << ", mean " << displacement.mean
+                          << ", p99 " << displacement.p99 << ", speedup " << speedup << ", update " << updateDisplacement << std::endl;
+                ++failures;
+            }
+
+            json << (firstRun ? "\n" : ",\n")
+                 << "  {\"mesh\": " << CoRTools::jsonString(rig.name)
+                 << ", \"vertices\": " << rig.vertices.size()
+                 << ", \"cors\": " << result.cors.size()
+                 << ", \"boundingBoxDiagonal\": " << diagonal
+                 << ", \"variant\": " << CoRTools::jsonString(variant)
+                 << ", \"maxError\": " << displacement.max
+                 << ", \"meanError\": " << displacement.mean
+                 << ", \"p50Error\": " << displacement.p50
+                 << ", \"p90Error\": " << displacement.p90
+                 << ", \"p99Error\": " << displacement.p99
+                 << ", \"referenceSeconds\": " << reference.seconds
+                 << ", \"seconds\": " << result.seconds
+                 << ", \"speedup\": " << speedup
+                 << ", \"updateError\": " << updateDisplacement
+                 << ", \"passed\": " << (passed ? "true" : "false") << "}";
+            firstRun = false;
+        }
+    }
+    json << "\n], \"failures\": " << failures << "}\n";
+
+    if (outputPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream output(outputPath);
+        output << json.str();
+        if (!output) {
+            std::cerr << "Error: Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,312 @@
+/*****************************************************************************
+Headless batch baking of the CoRs of FBX assets.
+
+Usage: cor_bake [--sigma 0.1] [--omega 0.1] [--subdivide 0|1] [--subdiv-epsilon 0.5]
+                [--calculator bruteforce|aggregated|pruned|bfs|hierarchical]
+                [--threads 0] [--concurrent 2] [--output-dir dir]
+                [--quantize 0|1] [--shard i/n] [--tile-size 0]
+                [--report report.json] <asset.fbx> [<asset.fbx> ...]
+
+--threads (0: one per hardware thread) is the budget of all bakes: each of
+the --concurrent bakes runs on its own thread, which works on the shared
+ThreadPool's tasks while it waits for them, so the pool gets the remaining
+--threads - --concurrent workers, at least one. The FBX SDK is not thread
+safe, the assets are loaded one after another while the earlier ones bake;
+an asset that cannot be loaded is reported with "loaded": false. Every asset
+is written as <name>.cors into --output-dir, by default next to the asset.
+--shard i/n bakes only the i-th of n vertex ranges of every asset into
+<name>.shard<i>, to be combined by cor_merge. The timing report is JSON,
+printed to stdout unless --report is given. --quantize writes 16 bit
+quantized, entropy coded .cors files and reports the max and mean cor
+displacement it causes, in absolute units and relative to the diagonal of the
+cors' bounding box; shards are always written as floats. --tile-size n bakes
+n vertices at a time into the checkpoint <name>.cors.checkpoint, so running
+an interrupted bake again resumes after its last complete tile; the checkpoint
+is removed once the .cors file is written. It does not apply to shards.
+*****************************************************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <cor/Clock.h>
+#include <cor/CoRCalculator.h>
+#include <cor/CoRCheckpoint.h>
+#include <cor/CoRFile.h>
+#include <cor/CoRQuantization.h>
+#include <cor/ThreadPool.h>
+
+#include "FBXLoader.h"
+#include "ToolOptions.h"
+
+namespace {
+    struct Settings {
+        float sigma = 0.1f;
+        float omega = 0.1f;
+        bool subdivide = false;
+        float subdivEpsilon = 0.5f;
+        std::string calculator = "aggregated";
+        std::string outputDir;
+        bool quantize = false;
+        unsigned long shardIndex = 0, shardCount = 0;
+        // 0 bakes without a checkpoint
+        unsigned int tileSize = 0;
+    };
+
+    // what a baked asset reports
+    struct BakeResult {
+        std::string asset;
+        std::string output;
+        bool loaded = false;
+        bool written = false;
+        unsigned long fileBytes = 0;
+        unsigned long vertices = 0, triangles = 0;
+        // taken from an earlier run's checkpoint
+        unsigned long resumedVertices = 0;
+        unsigned int bones = 0;
+        double loadSeconds = 0;
+        double createCoRMeshSeconds = 0;
+        double calculateCoRsSeconds = 0;
+        // CoRStats::toJSON of the bake, null if the asset was not loaded
+        std::string stats = "null";
+        // displacement of the quantized cors, only with --quantize
+        CoR::QuantizationError quantizationError;
+        float corDiagonal = 0;
+    };
+
+    std::string outputPath(const std::string &asset, const Settings &settings)
+    {
+        size_t slash = asset.find_last_of("\\/");
+        size_t dot = asset.find_last_of('.');
+        std::string stem = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? asset.substr(0, dot) : asset;
+        if (!settings.outputDir.empty())
+            stem = settings.outputDir + "/" + (slash == std::string::npos ? stem : stem.substr(slash + 1));
+
+        if (settings.shardCount > 0)
+            return stem + ".shard" + std::to_string(settings.shardIndex);
+        return stem + ".cors";
+    }
+
+    BakeResult bake(const FBXLoader::FBXMeshData &data, unsigned int bones, BakeResult result,
+                    const Settings &settings, const std::shared_ptr<CoR::ThreadPool> &pool)
+    {
+        std::unique_ptr<CoR::CoRCalculator> calculator = CoRTools::makeCalculator(
+                settings.calculator, settings.sigma, settings.omega, settings.subdivide, pool);
+
+        CoR::Clock clock;
+        clock.clockStart();
+        std::vector<CoR::WeightsPerBone> weights = calculator->convertWeights(bones, data.boneIndices, data.boneWeights);
+        CoR::CoRMesh mesh = calculator->createCoRMesh(data.vertices, data.faces, weights, settings.subdivEpsilon);
+        result.createCoRMeshSeconds = clock.elapsedSeconds();
+        result.vertices = mesh.vertices.size();
+        result.triangles = mesh.triangles.size();
+
+        clock.clockStart();
+        if (settings.shardCount > 0) {
+            unsigned long from = result.vertices * settings.shardIndex / settings.shardCount;
+            unsigned long to = result.vertices * (settings.shardIndex + 1) / settings.shardCount;
+            result.written = calculator->bakeCoRShard(mesh, from, to, result.output);
+        } else {
+            std::uint64_t hash = calculator->bakeHash(mesh);
+            std::string checkpointPath = result.output + ".checkpoint";
+            std::vector<glm::vec3> cors;
+            bool baked = true;
+            if (settings.tileSize > 0) {
+                CoR::CoRJob job;
+                baked = calculator->bakeCoRsTiled(mesh, checkpointPath, settings.tileSize, &job)
+                        && CoR::CoRCheckpoint::load(checkpointPath, cors, hash);
+                result.resumedVertices = job.resumed();
+            } else {
+                calculator->calculateCoRsAsync(mesh, [&cors](std::vector<glm::vec3> &baked) {
+                    cors.swap(baked);
+                })->wait();
+            }
+
+            if (baked && settings.quantize) {
+                CoR::QuantizedCoRs quantized = CoR::QuantizedCoRs::quantize(cors.data(), cors.size());
+                result.quantizationError = CoR::quantizationError(cors.data(), quantized);
+                result.corDiagonal = glm::length(quantized.extent);
+                result.written = CoR::writeCoRFile(result.output, quantized, hash);
+            } else if (baked) {
+                result.written = CoR::CoRCalculator::saveCoRsToBinaryFile(result.output, cors, hash);
+            }
+            if (result.written) {
+                result.fileBytes = static_cast<unsigned long>(std::ifstream(result.output, std::ios::binary | std::ios::ate).tellg());
+                if (settings.tileSize > 0)
+                    std::remove(checkpointPath.c_str());
+            }
+        }
+        result.calculateCoRsSeconds = clock.elapsedSeconds();
+        result.stats = calculator->stats().toJSON();
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    unsigned int threads = 0;
+    unsigned int concurrent = 2;
+    std::string reportPath;
+    std::vector<std::string> assets;
+
+    std::string shard;
+    bool parsed = CoRTools::parseOptions(argc, argv, [&](const std::string &option, const std::string &value) {
+        if (option == "--sigma")
+            settings.sigma = std::stof(value);
+        else if (option == "--omega")
+            settings.omega = std::stof(value);
+        else if (option == "--subdivide")
+            settings.subdivide = value != "0";
+        else if (option == "--subdiv-epsilon")
+            settings.subdivEpsilon = std::stof(value);
+        else if (option == "--calculator")
+            settings.calculator = value;
+        else if (option == "--threads")
+            threads = static_cast<unsigned int>(std::stoul(value));
+        else if (option == "--concurrent")
+            concurrent = std::max(1u, static_cast<unsigned int>(std::stoul(value)));
+        else if (option == "--output-dir")
+            settings.outputDir = value;
+        else if (option == "--quantize")
+            settings.quantize = value != "0";
+        else if (option == "--shard")
+            shard = value;
+        else if (option == "--tile-size")
+            settings.tileSize = static_cast<unsigned int>(std::stoul(value));
+        else if (option == "--report")
+            reportPath = value;
+        else
+            return false;
+        return true;
+    }, &assets);
+    if (!parsed)
+        return 2;
+    if (!shard.empty()) {
+        size_t slash = shard.find('/');
+        if (slash == std::string::npos) {
+            std::cerr << "Error: --shard expects i/n" << std::endl;
+            return 2;
+        }
+        settings.shardIndex = std::stoul(shard.substr(0, slash));
+        settings.shardCount = std::stoul(shard.substr(slash + 1));
+        if (settings.shardIndex >= settings.shardCount) {
+            std::cerr << "Error: Shard " << shard << " does not exist" << std::endl;
+            return 2;
+        }
+    }
+    if (settings.tileSize > 0 && settings.shardCount > 0) {
+        std::cerr << "Error: --tile-size does not apply to --shard" << std::endl;
+        return 2;
+    }
+    if (assets.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [options] <asset.fbx> [<asset.fbx> ...]" << std::endl;
+        return 2;
+    }
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    // the bake threads run pool tasks too
+    std::shared_ptr<CoR::ThreadPool> pool = std::make_shared<CoR::ThreadPool>(threads > concurrent ? threads - concurrent : 1);
+    CoR::Clock total;
+    total.clockStart();
+
+    // the loaders stay alive until their bake is done, the bakes read the mesh data in place
+    std::deque<std::unique_ptr<FBXLoader>> loaders;
+    // results in asset order, a running bake fills in the entry of its asset
+    std::deque<std::pair<size_t, std::future<BakeResult>>> running;
+    std::vector<BakeResult> results(assets.size());
+    bool failed = false;
+
+    for (size_t a = 0; a < assets.size(); ++a) {
+        const std::string &asset = assets[a];
+        while (running.size() >= concurrent) {
+            results[running.front().first] = running.front().second.get();
+            running.pop_front();
+            loaders.pop_front();
+        }
+
+        BakeResult &result = results[a];
+        result.asset = asset;
+        result.output = outputPath(asset, settings);
+
+        CoR::Clock clock;
+        clock.clockStart();
+        std::unique_ptr<FBXLoader> loader(new FBXLoader());
+        if (!loader->LoadScene(asset.c_str())) {
+            std::cerr << "Error: Cannot load FBX " << asset << std::endl;
+            failed = true;
+            continue;
+        }
+        result.loaded = true;
+        result.loadSeconds = clock.elapsedSeconds();
+        result.bones = loader->GetSkeletonData().numberOfBones;
+        std::cerr << "Baking " << asset << " (" << loader->GetMeshData().vertices.size() << " vertices)" << std::endl;
+
+        running.push_back(std::make_pair(a, std::async(std::launch::async, bake, std::cref(loader->GetMeshData()), result.bones, result,
+                                                       std::cref(settings), std::cref(pool))));
+        loaders.push_back(std::move(loader));
+    }
+    while (!running.empty()) {
+        results[running.front().first] = running.front().second.get();
+        running.pop_front();
+    }
+
+    std::ostringstream json;
+    json << "{\"threads\": " << threads << ", \"poolWorkers\": " << pool->size() << ", \"concurrent\": " << concurrent
+         << ", \"calculator\": " << CoRTools::jsonString(settings.calculator)
+         << ", \"sigma\": " << settings.sigma << ", \"omega\": " << settings.omega
+         << ", \"subdivide\": " << (settings.subdivide ? "true" : "false")
+         << ", \"quantize\": " << (settings.quantize ? "true" : "false")
+         << ", \"totalSeconds\": " << total.elapsedSeconds()
+         << ", \"assets\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BakeResult &result = results[i];
+        if (result.loaded && !result.written) {
+            std::cerr << "Error: Cannot write " << result.output << std::endl;
+            failed = true;
+        }
+        json << (i == 0 ? "\n" : ",\n")
+             << "  {\"asset\": " << CoRTools::jsonString(result.asset)
+             << ", \"output\": " << CoRTools::jsonString(result.output)
+             << ", \"loaded\": " << (result.loaded ? "true" : "false")
+             << ", \"written\": " << (result.written ? "true" : "false")
+             << ", \"fileBytes\": " << result.fileBytes
+             << ", \"vertices\": " << result.vertices
+             << ", \"triangles\": " << result.triangles
+             << ", \"resumedVertices\": " << result.resumedVertices
+             << ", \"bones\": " << result.bones
+             << ", \"loadSeconds\": " << result.loadSeconds
+             << ", \"createCoRMeshSeconds\": " << result.createCoRMeshSeconds
+             << ", \"calculateCoRsSeconds\": " << result.calculateCoRsSeconds
+             << ", \"stats\": " << result.stats;
+        if (settings.quantize && settings.shardCount == 0)
+            json << ", \"quantizationMaxError\": " << result.quantizationError.max
+                 << ", \"quantizationMeanError\": " << result.quantizationError.mean
+                 << ", \"quantizationMaxRelativeError\": "
+                 << (result.corDiagonal > 0 ? result.quantizationError.max / result.corDiagonal : 0.0f);
+        json << "}";
+    }
+    json << "\n]}\n";
+
+    if (reportPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream report(reportPath);
+        report << json.str();
+        if (!report) {
+            std::cerr << "Error: Cannot write " << reportPath << std::endl;
+            return 1;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+/*****************************************************************************
+Times CoR baking on synthetic rigs and prints the results as JSON.
+
+Usage: cor_benchmark [--rigs cylinder,hand,humanoid] [--sizes 10000,100000]
+                     [--threads 1,4] [--calculators bruteforce,bfs,hierarchical]
+                     [--sigma 0.1] [--omega 0.1] [--subdivide 0|1]
+                     [--brute-force-limit 200000] [--output results.json]
+
+Every rig, size, calculator and thread count is one run. A run times
+convertWeights, createCoRMesh (which includes calculateANNData for the BFS
+calculator) and calculateCoRsAsync, and records the calculator's CoRStats.
+The brute force calculator is skipped above --brute-force-limit vertices.
+--calculators also takes aggregated and pruned.
+*****************************************************************************/
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cor/Clock.h>
+#include <cor/CoRCalculator.h>
+#include <cor/SimilarityKernel.h>
+
+#include "SyntheticRigs.h"
+#include "ToolOptions.h"
+
+int main(int argc, char **argv)
+{
+    unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<std::string> rigs = CoRTools::rigKinds();
+    std::vector<unsigned long> sizes = {10000, 100000};
+    std::vector<unsigned long> threadCounts = {1};
+    if (hardwareThreads > 1)
+        threadCounts.push_back(hardwareThreads);
+    std::vector<std::string> calculators = {"bruteforce", "bfs", "hierarchical"};
+    float sigma = 0.1f, omega = 0.1f;
+    bool subdivide = false;
+    unsigned long bruteForceLimit = 200000;
+    std::string outputPath;
+
+    bool parsed = CoRTools::parseOptions(argc, argv, [&](const std::string &option, const std::string &value) {
+        if (option == "--rigs")
+            rigs = CoRTools::splitList(value);
+        else if (option == "--sizes")
+            sizes = CoRTools::splitNumbers(value);
+        else if (option == "--threads")
+            threadCounts = CoRTools::splitNumbers(value);
+        else if (option == "--calculators")
+            calculators = CoRTools::splitList(value);
+        else if (option == "--sigma")
+            sigma = std::stof(value);
+        else if (option == "--omega")
+            omega = std::stof(value);
+        else if (option == "--subdivide")
+            subdivide = value != "0";
+        else if (option == "--brute-force-limit")
+            bruteForceLimit = std::stoul(value);
+        else if (option == "--output")
+            outputPath = value;
+        else
+            return false;
+        return true;
+    });
+    if (!parsed)
+        return 2;
+
+    std::ostringstream json;
+    json << "{\"hardwareThreads\": " << hardwareThreads
+         << ", \"similarityKernel\": " << CoRTools::jsonString(CoR::SimilarityKernel::instructionSet())
+         << ", \"sigma\": " << sigma << ", \"omega\": " << omega << ", \"subdivide\": " << (subdivide ? "true" : "false")
+         << ", \"runs\": [";
+    bool firstRun = true;
+
+    for (const std::string &kind : rigs) {
+        for (unsigned long size : sizes) {
+            const CoRTools::SyntheticRig rig = CoRTools::makeSyntheticRig(kind, size);
+
+            for (const std::string &calculatorName : calculators) {
+                if (calculatorName == "bruteforce" && rig.vertices.size() > bruteForceLimit) {
+                    std::cerr << "Skipping bruteforce on " << rig.name << " with " << rig.vertices.size() << " vertices" << std::endl;
+                    continue;
+                }
+
+                for (unsigned long threads : threadCounts) {
+                    std::cerr << rig.name << " " << rig.vertices.size() << " vertices, " << calculatorName << ", " << threads << " threads" << std::endl;
+                    std::unique_ptr<CoR::CoRCalculator> calculator = CoRTools::makeCalculator(calculatorName, sigma, omega, subdivide, static_cast<unsigned int>(threads));
+
+                    CoR::Clock clock;
+                    clock.clockStart();
+                    std::vector<CoR::WeightsPerBone> weights = calculator->convertWeights(rig.boneCount, rig.boneIndices, rig.boneWeights);
+                    double convertSeconds = clock.elapsedSeconds();
+
+                    clock.clockStart();
+                    CoR::CoRMesh mesh = calculator->createCoRMesh(
+                            std::vector<glm::vec3>(rig.vertices), std::vector<unsigned int>(rig.indices), std::move(weights));
+                    double meshSeconds = clock.elapsedSeconds();
+
+                    clock.clockStart();
+                    std::shared_ptr<CoR::CoRJob> job = calculator->calculateCoRsAsync(mesh, nullptr);
+                    job->wait();
+                    double corSeconds = clock.elapsedSeconds();
+
+                    CoR::CoRStats stats = calculator->stats();
+                    json << (firstRun ? "\n" : ",\n")
+                         << "  {\"rig\": " << CoRTools::jsonString(rig.name)
+                         << ", \"vertices\": " << mesh.vertices.size()
+                         << ", \"triangles\": " << mesh.triangles.size()
+                         << ", \"bones\": " << rig.boneCount
+                         << ", \"calculator\": " << CoRTools::jsonString(calculatorName)
+                         << ", \"threads\": " << threads
+                         << ", \"convertWeightsSeconds\": " << convertSeconds
+                         << ", \"createCoRMeshSeconds\": " << meshSeconds
+                         << ", \"calculateANNDataSeconds\": " << stats.stageSeconds("bfsData")
+                         << ", \"calculateCoRsSeconds\": " << corSeconds
+                         << ", \"corsPerSecond\": " << (corSeconds > 0 ? mesh.vertices.size() / corSeconds : 0)
+                         << ", \"stats\": " << stats.toJSON() << "}";
+                    firstRun = false;
+                }
+            }
+        }
+    }
+    json << "\n]}\n";
+
+    if (outputPath.empty()) {
+        std::cout << json.str();
+    } else {
+        std::ofstream output(outputPath);
+        output << json.str();
+        if (!output) {
+            std::cerr << "Error: Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
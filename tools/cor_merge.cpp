@@ -0,0 +1,43 @@
+/*****************************************************************************
+Merges the CoR shards of a multi-process bake into one .cors file.
+
+Usage: cor_merge <output.cors> <shard> [<shard> ...]
+*****************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <cor/CoRCalculator.h>
+#include <cor/CoRShard.h>
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <output.cors> <shard> [<shard> ...]" << std::endl;
+        return 2;
+    }
+
+    std::vector<CoR::CoRShard> shards(argc - 2);
+    for (int i = 2; i < argc; ++i) {
+        if (!shards[i - 2].read(argv[i])) {
+            std::cerr << "Error: " << argv[i] << " is not a complete CoR shard" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<glm::vec3> cors;
+    std::string error;
+    if (!CoR::mergeCoRShards(shards, cors, error)) {
+        std::cerr << "Error: Cannot merge shards: " << error << std::endl;
+        return 1;
+    }
+
+    if (!CoR::CoRCalculator::saveCoRsToBinaryFile(argv[1], cors, shards.front().hash)) {
+        std::cerr << "Error: Cannot write " << argv[1] << std::endl;
+        return 1;
+    }
+    std::cout << "Merged " << shards.size() << " shards into " << cors.size() << " cors (bake hash "
+              << std::hex << shards.front().hash << std::dec << ")" << std::endl;
+    return 0;
+}